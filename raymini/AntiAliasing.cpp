@@ -1,7 +1,7 @@
 #include <cmath>
-#include <cstdlib>
 
 #include "AntiAliasing.h"
+#include "Sampler.h"
 
 using namespace std;
 
@@ -48,11 +48,8 @@ vector<pair<float, float> > AntiAliasing::generateOffsets(Type type, unsigned ra
 
         case STOCHASTIC: {
                 // Picked using randomness
-                for (unsigned int i=0; i<rays; i++) {
-                    float di = (float)rand() / (float)RAND_MAX;
-                    float dj = (float)rand() / (float)RAND_MAX;
-                    offsets.push_back(make_pair(di, dj));
-                }
+                offsets.resize(rays);
+                Sampler::local().get2D(rays, offsets.data());
             }
             break;
         }
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cassert>
+
+#include "BVH.h"
+#include "Object.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+using namespace std;
+
+static inline BoundingBox worldBoundingBox(const Object *o) {
+    return o->getMotionBoundingBox();
+}
+
+void BVH::build(const vector<Object *> &sceneObjects) {
+    nodes.clear();
+    objects.clear();
+    if (sceneObjects.empty()) {
+        return;
+    }
+
+    vector<BoundingBox> boxes;
+    vector<unsigned> indices;
+    for (unsigned i = 0 ; i < sceneObjects.size() ; i++) {
+        boxes.push_back(worldBoundingBox(sceneObjects[i]));
+        indices.push_back(i);
+    }
+
+    nodes.reserve(2*sceneObjects.size());
+    depth = 0;
+    build(indices, 0, indices.size(), boxes, 0);
+    // Traversals hold at most one node more than the depth, median splits
+    // keep it logarithmic
+    assert(depth < MAX_DEPTH);
+
+    for (unsigned i : indices) {
+        objects.push_back(sceneObjects[i]);
+    }
+}
+
+unsigned BVH::build(vector<unsigned> &indices, unsigned begin, unsigned end,
+                    const vector<BoundingBox> &boxes, unsigned nodeDepth) {
+    unsigned index = nodes.size();
+    nodes.push_back(Node());
+    depth = max(depth, nodeDepth);
+
+    BoundingBox bBox = boxes[indices[begin]];
+    BoundingBox centers(bBox.getCenter());
+    for (unsigned i = begin+1 ; i < end ; i++) {
+        bBox.extendTo(boxes[indices[i]]);
+        centers.extendTo(boxes[indices[i]].getCenter());
+    }
+    nodes[index].bBox = bBox;
+
+    if (end - begin <= MAX_OBJECTS_PER_LEAF) {
+        nodes[index].offset = begin;
+        nodes[index].nbObjects = end - begin;
+        nodes[index].axis = 0;
+        return index;
+    }
+
+    // Median split of the centers along their largest extent
+    unsigned axis = 0;
+    if (centers.getHeight() > centers.getWidth()) axis = 1;
+    if (centers.getLength() > max(centers.getWidth(), centers.getHeight())) axis = 2;
+
+    unsigned middle = (begin + end) / 2;
+    nth_element(indices.begin()+begin, indices.begin()+middle, indices.begin()+end,
+                [&](unsigned a, unsigned b) {
+                    return boxes[a].getMiddle(axis) < boxes[b].getMiddle(axis);
+                });
+
+    build(indices, begin, middle, boxes, nodeDepth+1);
+    unsigned right = build(indices, middle, end, boxes, nodeDepth+1);
+    nodes[index].offset = right;
+    nodes[index].nbObjects = 0;
+    nodes[index].axis = axis;
+    return index;
+}
+
+void BVH::update(const vector<Object *> &sceneObjects) {
+    if (sceneObjects.size() != objects.size()) {
+        build(sceneObjects);
+    }
+    else {
+        refit();
+    }
+}
+
+void BVH::refit() {
+    // Children always follow their parent
+    for (unsigned i = nodes.size() ; i-- > 0 ; ) {
+        Node & n = nodes[i];
+        if (n.isLeaf()) {
+            n.bBox = worldBoundingBox(objects[n.offset]);
+            for (unsigned j = 1 ; j < n.nbObjects ; j++) {
+                n.bBox.extendTo(worldBoundingBox(objects[n.offset+j]));
+            }
+        }
+        else {
+            n.bBox = nodes[i+1].bBox;
+            n.bBox.extendTo(nodes[n.offset].bBox);
+        }
+    }
+}
+
+bool BVH::intersect(const Vec3Df &origin, const Vec3Df &direction, float time, Ray &bestRay) const {
+    bestRay = Ray(origin, direction, time);
+    if (nodes.empty()) {
+        return false;
+    }
+
+    // Every object updates the same hit, so that each traversal skips what
+    // is behind the closest hit found so far
+    const BasicRay & ray = bestRay.getBasicRay();
+    Hit & hit = bestRay.getHit();
+    // Ray keeps squared distances, compare them with t^2 |dir|^2
+    const float dirLength2 = direction.getSquaredLength();
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+
+    struct ToDo {
+        unsigned node;
+        float tMin;
+    } todo[MAX_DEPTH];
+    unsigned todoPos = 0;
+    todo[todoPos++] = {0, 0.f};
+
+    while (todoPos) {
+        const ToDo current = todo[--todoPos];
+        if (hit.distance < current.tMin*current.tMin*dirLength2) {
+            continue;
+        }
+
+        const Node & n = nodes[current.node];
+        float tMin = 0.f, tMax = 1e30f;
+        // Flat boxes (planes) would be missed without a little padding
+        BoundingBox padded(n.bBox.getMin()-pad, n.bBox.getMax()+pad);
+        if (!ray.clip(padded, tMin, tMax)) {
+            continue;
+        }
+        if (hit.distance < tMin*tMin*dirLength2) {
+            continue;
+        }
+
+        if (n.isLeaf()) {
+            for (unsigned i = n.offset ; i < n.offset + n.nbObjects ; i++) {
+                Object *o = objects[i];
+                if (!o->isEnabled()) {
+                    continue;
+                }
+                // Hits are kept in object space, distances do not depend on it
+                o->getKDtree().intersect(ray.translated(-o->getTrans(time)), hit);
+            }
+        }
+        else {
+            // Push the far child first
+            if (direction[n.axis] > 0) {
+                todo[todoPos++] = {n.offset, tMin};
+                todo[todoPos++] = {current.node+1, tMin};
+            }
+            else {
+                todo[todoPos++] = {current.node+1, tMin};
+                todo[todoPos++] = {n.offset, tMin};
+            }
+        }
+    }
+
+    return hit.found();
+}
+
+bool BVH::occluded(const Vec3Df &origin, const Vec3Df &direction, float time, float tMax) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const BasicRay ray(origin, direction, time);
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+
+    unsigned todo[MAX_DEPTH];
+    unsigned todoPos = 0;
+    todo[todoPos++] = 0;
+
+    while (todoPos) {
+        const unsigned current = todo[--todoPos];
+        const Node & n = nodes[current];
+        float tMin = 0.f, tFar = tMax;
+        BoundingBox padded(n.bBox.getMin()-pad, n.bBox.getMax()+pad);
+        if (!ray.clip(padded, tMin, tFar)) {
+            continue;
+        }
+
+        if (n.isLeaf()) {
+            for (unsigned i = n.offset ; i < n.offset + n.nbObjects ; i++) {
+                const Object *o = objects[i];
+                if (!o->isEnabled() || o->getMaterial().isTransparent()) {
+                    continue;
+                }
+                if (o->getKDtree().occluded(ray.translated(-o->getTrans(time)), tMax)) {
+                    return true;
+                }
+            }
+        }
+        else {
+            todo[todoPos++] = n.offset;
+            todo[todoPos++] = current+1;
+        }
+    }
+
+    return false;
+}
+
+/** Bounds of the product of two intervals */
+static inline void intervalProduct(float aMin, float aMax, float bMin, float bMax,
+                                   float &pMin, float &pMax) {
+    const float p1 = aMin*bMin, p2 = aMin*bMax, p3 = aMax*bMin, p4 = aMax*bMax;
+    pMin = min(min(p1, p2), min(p3, p4));
+    pMax = max(max(p1, p2), max(p3, p4));
+}
+
+bool BVH::intersect(RayPacket &packet) const {
+    static const unsigned SIZE = RayPacket::SIZE;
+
+    if (!packet.isCoherent()) {
+        bool hit = false;
+        for (unsigned r = 0 ; r < SIZE ; r++) {
+            if (packet.isActive(r)) {
+                const Vec3Df origin = packet.rays[r].getOrigin();
+                const Vec3Df direction = packet.rays[r].getDirection();
+                hit |= intersect(origin, direction, packet.rays[r].getTime(), packet.rays[r]);
+            }
+        }
+        return hit;
+    }
+
+    for (unsigned r = 0 ; r < SIZE ; r++) {
+        const Ray & ray = packet.rays[r];
+        packet.rays[r] = Ray(ray.getOrigin(), ray.getDirection(), ray.getTime());
+    }
+    if (nodes.empty() || !packet.mask) {
+        return false;
+    }
+
+    // Interval bounds of origins and inverse directions over the packet
+    Vec3Df origins[SIZE];
+    Vec3Df oMin, oMax, iMin, iMax;
+    float minDirLength2 = 0.f;
+    bool first = true;
+    for (unsigned r = 0 ; r < SIZE ; r++) {
+        if (!packet.isActive(r)) {
+            continue;
+        }
+        const Vec3Df & o = packet.rays[r].getOrigin();
+        const Vec3Df & d = packet.rays[r].getDirection();
+        const Vec3Df & inv = packet.rays[r].getBasicRay().invDirection;
+        origins[r] = o;
+        if (first) {
+            oMin = oMax = o;
+            iMin = iMax = inv;
+            minDirLength2 = d.getSquaredLength();
+            first = false;
+        }
+        for (unsigned a = 0 ; a < 3 ; a++) {
+            oMin[a] = min(oMin[a], o[a]);
+            oMax[a] = max(oMax[a], o[a]);
+            iMin[a] = min(iMin[a], inv[a]);
+            iMax[a] = max(iMax[a], inv[a]);
+        }
+        minDirLength2 = min(minDirLength2, d.getSquaredLength());
+    }
+    const Vec3Df & dir = packet.rays[__builtin_ctz(packet.mask)].getDirection();
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+
+    unsigned todo[MAX_DEPTH];
+    unsigned todoPos = 0;
+    todo[todoPos++] = 0;
+
+    while (todoPos) {
+        const Node & n = nodes[todo[--todoPos]];
+        const unsigned current = &n - &nodes[0];
+
+        // Interval slab test: no ray of the packet enters before tEnter or leaves after tExit
+        const Vec3Df bMin = n.bBox.getMin()-pad, bMax = n.bBox.getMax()+pad;
+        float tEnter = 0.f, tExit = 1e30f;
+        for (unsigned a = 0 ; a < 3 ; a++) {
+            float nearMin, nearMax, farMin, farMax;
+            const float & near = dir[a] > 0 ? bMin[a] : bMax[a];
+            const float & far = dir[a] > 0 ? bMax[a] : bMin[a];
+            intervalProduct(near-oMax[a], near-oMin[a], iMin[a], iMax[a], nearMin, nearMax);
+            intervalProduct(far-oMax[a], far-oMin[a], iMin[a], iMax[a], farMin, farMax);
+            tEnter = max(tEnter, nearMin);
+            tExit = min(tExit, farMax);
+        }
+        if (tEnter > tExit) {
+            continue;
+        }
+
+        // Every ray already hit something before this node
+        bool closer = true;
+        for (unsigned r = 0 ; r < SIZE && closer ; r++) {
+            const Ray & ray = packet.rays[r];
+            closer = !packet.isActive(r) ||
+                (ray.intersect() && ray.getIntersectionDistance() < tEnter*tEnter*minDirLength2);
+        }
+        if (closer) {
+            continue;
+        }
+
+        if (n.isLeaf()) {
+            for (unsigned i = n.offset ; i < n.offset + n.nbObjects ; i++) {
+                Object *o = objects[i];
+                if (!o->isEnabled()) {
+                    continue;
+                }
+                // Hits are kept in object space, distances do not depend on it
+                for (unsigned r = 0 ; r < SIZE ; r++) {
+                    if (packet.isActive(r)) {
+                        packet.rays[r].getOrigin() = origins[r] - o->getTrans(packet.rays[r].getTime());
+                    }
+                }
+                o->getKDtree().intersect(packet);
+            }
+            for (unsigned r = 0 ; r < SIZE ; r++) {
+                if (packet.isActive(r)) {
+                    packet.rays[r].getOrigin() = origins[r];
+                }
+            }
+        }
+        else {
+            // Push the far child first
+            if (dir[n.axis] > 0) {
+                todo[todoPos++] = n.offset;
+                todo[todoPos++] = current+1;
+            }
+            else {
+                todo[todoPos++] = current+1;
+                todo[todoPos++] = n.offset;
+            }
+        }
+    }
+
+    bool hit = false;
+    for (unsigned r = 0 ; r < SIZE ; r++) {
+        hit |= packet.isActive(r) && packet.rays[r].intersect();
+    }
+    return hit;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "BoundingBox.h"
+#include "Vec3D.h"
+
+class Object;
+class Ray;
+class RayPacket;
+
+/**
+ * Top level bounding volume hierarchy over the translated boxes of objects
+ *
+ * Objects' KDtrees are the bottom level.
+ * Nodes are stored depth first: the left child follows its parent,
+ * the right one is referenced by index.
+ * Boxes of mobile objects cover their whole motion, so that rays of any
+ * time share the hierarchy. Editing objects only needs a refit, the
+ * hierarchy is rebuilt when objects are added or removed.
+ */
+class BVH {
+public:
+    static const unsigned MAX_OBJECTS_PER_LEAF = 2;
+
+    class Node {
+    public:
+        BoundingBox bBox;
+        /** Right child if interior, first object if leaf */
+        unsigned offset;
+        /** 0 if interior */
+        unsigned nbObjects;
+        unsigned axis;
+
+        inline bool isLeaf() const { return nbObjects > 0; }
+    };
+
+    BVH() {}
+
+    /** Build the hierarchy from scratch */
+    void build(const std::vector<Object *> &objects);
+
+    /** Update boxes after objects were edited, rebuild if objects were added or removed */
+    void update(const std::vector<Object *> &objects);
+
+    /**
+     * Closest hit among enabled objects placed at time, in bestRay
+     * origin and direction are in world space
+     */
+    bool intersect(const Vec3Df &origin, const Vec3Df &direction, float time, Ray &bestRay) const;
+
+    /**
+     * True if an enabled opaque object placed at time is hit at
+     * origin + t * direction with 0 <= t < tMax, in world space
+     */
+    bool occluded(const Vec3Df &origin, const Vec3Df &direction, float time, float tMax) const;
+
+    /**
+     * Closest hits of every active ray of packet, in world space
+     * Coherent packets are culled against node boxes as a whole,
+     * the others are traced ray by ray
+     */
+    bool intersect(RayPacket &packet) const;
+
+    inline const std::vector<Node> & getNodes() const { return nodes; }
+
+private:
+    /** Size of the traversal stacks, above depth */
+    static const unsigned MAX_DEPTH = 64;
+
+    std::vector<Node> nodes;
+    std::vector<Object *> objects;
+    /** Depth of the deepest leaf */
+    unsigned depth = 0;
+
+    unsigned build(std::vector<unsigned> &indices, unsigned begin, unsigned end,
+                   const std::vector<BoundingBox> &boxes, unsigned nodeDepth);
+    void refit();
+};
@@ -0,0 +1,35 @@
+/**
+ * What the rendering core needs from whoever drives it
+ *
+ * Controller implements it for the GUI, CliController for batch renders.
+ */
+
+#pragma once
+
+#include <QObject>
+
+#include "Vertex.h"
+
+class Scene;
+class RayTracer;
+class PBGI;
+
+class BaseController : public QObject {
+    Q_OBJECT
+public:
+    virtual ~BaseController() {}
+
+    virtual const Scene *getScene() = 0;
+    virtual const RayTracer *getRayTracer() = 0;
+    /** Null if point based global illumination is not available */
+    virtual const PBGI *getPBGI() = 0;
+
+    /** True while the view keeps refining the same picture */
+    virtual bool isRealTime() = 0;
+    virtual Vertex getFocusPoint() = 0;
+    /** True if the picture being rendered is no longer wanted */
+    virtual bool isEmergencyStop() = 0;
+
+public slots:
+    virtual void renderProgressed(float) = 0;
+};
@@ -0,0 +1,290 @@
+#include <QCoreApplication>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CliController.h"
+#include "MeshCache.h"
+
+using namespace std;
+
+/** Built-in scenes of Scene::Scene, "mesh" needs a file and is left out */
+static const vector<string> SCENES = {"room", "rs", "rsm", "rsglas", "rsglos", "lights",
+                                      "meshs", "outdoor", "pool", "mg", "sphere"};
+
+static const unsigned AO_RAYS = 8;
+
+static void printBenchUsage(const char *name) {
+    cerr << endl
+         << "Render every built-in scene with fixed cameras and seeds: " << name << " [options]" << endl
+         << "\t--scenes <a,b,...>: scenes to render (all)" << endl
+         << "\t--size <width>x<height>: picture size (320x240)" << endl
+         << "\t--repeat <N>: renders per scene, the fastest is kept (3)" << endl
+         << "\t--seed <N>: random seed of the renders (1)" << endl
+         << "\t--cache <on|off>: read and write mesh caches, KDtrees are not built when on (off)" << endl
+         << "\t-o <file>: JSON results (standard output)" << endl
+         << "\t--baseline <file>: JSON results to compare with" << endl
+         << "\t--tolerance <ratio>: slow down over which the comparison fails (0.05)" << endl
+         << endl;
+    exit(1);
+}
+
+class BenchResult {
+public:
+    string name;
+    float loadTime;
+    float kdtreeBuildTime;
+    unsigned kdtreeNodes;
+    unsigned kdtreeLeaves;
+    float renderTime;
+    unsigned long long rays[RayTracer::NB_RAY_TYPES];
+    long peakMemory;
+
+    inline unsigned long long getNbRays() const {
+        return rays[RayTracer::PRIMARY_RAY] + rays[RayTracer::SHADOW_RAY] + rays[RayTracer::SECONDARY_RAY];
+    }
+    inline double getRaysPerSecond() const {
+        return renderTime > 0 ? getNbRays()/(renderTime/1000.) : 0;
+    }
+};
+
+static ostream & operator<<(ostream &os, const BenchResult &r) {
+    return os << "{\"name\": \"" << r.name << "\""
+              << ", \"load_ms\": " << r.loadTime
+              << ", \"kdtree_build_ms\": " << r.kdtreeBuildTime
+              << ", \"kdtree_nodes\": " << r.kdtreeNodes
+              << ", \"kdtree_leaves\": " << r.kdtreeLeaves
+              << ", \"render_ms\": " << r.renderTime
+              << ", \"primary_rays\": " << r.rays[RayTracer::PRIMARY_RAY]
+              << ", \"shadow_rays\": " << r.rays[RayTracer::SHADOW_RAY]
+              << ", \"secondary_rays\": " << r.rays[RayTracer::SECONDARY_RAY]
+              << ", \"rays_per_second\": " << (unsigned long long)r.getRaysPerSecond()
+              << ", \"peak_memory_kb\": " << r.peakMemory << "}";
+}
+
+/** Load and render one scene, in the current process */
+static BenchResult runScene(char *program, const string &name, unsigned width, unsigned height,
+                            unsigned repeat, unsigned seed) {
+    BenchResult r;
+    r.name = name;
+
+    CliController controller;
+    string id(name);
+    char *sceneArgv[2] = {program, &id[0]};
+    auto start = chrono::steady_clock::now();
+    controller.initAll(2, sceneArgv);
+    r.loadTime = chrono::duration<float, milli>(chrono::steady_clock::now()-start).count();
+
+    const Scene *scene = controller.getScene();
+    r.kdtreeBuildTime = 0;
+    r.kdtreeNodes = r.kdtreeLeaves = 0;
+    for (const Object *o : scene->getObjects()) {
+        const KDtree::Stats &stats = o->getKDtree().getStats();
+        r.kdtreeBuildTime += stats.buildTime;
+        r.kdtreeNodes += stats.nbNodes;
+        r.kdtreeLeaves += stats.nbLeaves;
+    }
+
+    RayTracer *rayTracer = controller.getEditableRayTracer();
+    rayTracer->setSeed(seed);
+    rayTracer->setShadowMode(Shadow::HARD);
+    rayTracer->setNbRayAmbientOcclusion(AO_RAYS);
+
+    // Fixed camera framing the bounding box of the scene
+    const BoundingBox &bBox = scene->getBoundingBox();
+    Vec3Df direction(0.6f, -1.5f, 0.9f);
+    direction.normalize();
+    const Vec3Df target = bBox.getCenter();
+    const Vec3Df camPos = target + 2.f*bBox.getRadius()*direction;
+    controller.setFocusPoint(Vertex(target, Vec3Df(0, 0, 1)));
+
+    r.renderTime = 0;
+    for (unsigned i = 0; i < repeat; i++) {
+        start = chrono::steady_clock::now();
+        controller.render(camPos, target, Vec3Df(0, 0, 1), 45, width, height);
+        float time = chrono::duration<float, milli>(chrono::steady_clock::now()-start).count();
+        if (i == 0 || time < r.renderTime) {
+            r.renderTime = time;
+            for (unsigned t = 0; t < RayTracer::NB_RAY_TYPES; t++) {
+                r.rays[t] = rayTracer->getNbRays(RayTracer::RayType(t));
+            }
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    r.peakMemory = usage.ru_maxrss;
+    return r;
+}
+
+/**
+ * Run runScene in a child process, so that every scene gets its own peak memory
+ * The child sends its JSON result through a pipe
+ */
+static bool runSceneInChild(char *program, const string &name, unsigned width, unsigned height,
+                            unsigned repeat, unsigned seed, string &json) {
+    int fd[2];
+    if (pipe(fd)) {
+        return false;
+    }
+    cout.flush();
+    cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        ostringstream os;
+        os << runScene(program, name, width, height, repeat, seed);
+        const string s = os.str();
+        bool written = write(fd[1], s.c_str(), s.size()) == ssize_t(s.size());
+        close(fd[1]);
+        _exit(written ? 0 : 1);
+    }
+
+    close(fd[1]);
+    json.clear();
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd[0], buffer, sizeof(buffer))) > 0) {
+        json.append(buffer, n);
+    }
+    close(fd[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && !json.empty();
+}
+
+/** Value of a numeric field of every scene of JSON results, by scene name */
+static map<string, double> readField(const string &json, const string &field) {
+    map<string, double> values;
+    const string nameKey = "\"name\": \"";
+    const string fieldKey = "\"" + field + "\": ";
+    for (size_t p = json.find(nameKey); p != string::npos; p = json.find(nameKey, p)) {
+        p += nameKey.size();
+        const string name = json.substr(p, json.find('"', p) - p);
+        const size_t end = json.find('}', p);
+        const size_t f = json.find(fieldKey, p);
+        if (f != string::npos && f < end) {
+            values[name] = atof(json.c_str() + f + fieldKey.size());
+        }
+    }
+    return values;
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication raymini(argc, argv);
+
+    vector<string> scenes = SCENES;
+    unsigned width = 320, height = 240, repeat = 3, seed = 1;
+    MeshCache::enabled = false;
+    string output, baseline;
+    float tolerance = 0.05f;
+
+    for (int a = 1; a < argc; a++) {
+        string opt(argv[a]);
+        if (a+1 >= argc) {
+            printBenchUsage(argv[0]);
+        }
+        const char *value = argv[++a];
+        if (opt == "--scenes") {
+            scenes.clear();
+            stringstream ss(value);
+            string s;
+            while (getline(ss, s, ',')) {
+                if (find(SCENES.begin(), SCENES.end(), s) == SCENES.end()) {
+                    cerr << "Unknown scene: " << s << endl;
+                    printBenchUsage(argv[0]);
+                }
+                scenes.push_back(s);
+            }
+        }
+        else if (opt == "--size") {
+            if (sscanf(value, "%ux%u", &width, &height) != 2 || !width || !height) {
+                printBenchUsage(argv[0]);
+            }
+        }
+        else if (opt == "--repeat") repeat = max(atoi(value), 1);
+        else if (opt == "--seed") seed = atoi(value);
+        else if (opt == "--cache") MeshCache::enabled = string(value) == "on";
+        else if (opt == "-o") output = value;
+        else if (opt == "--baseline") baseline = value;
+        else if (opt == "--tolerance") tolerance = atof(value);
+        else printBenchUsage(argv[0]);
+    }
+
+    ostringstream json;
+    json << "{" << endl
+         << "  \"width\": " << width << "," << endl
+         << "  \"height\": " << height << "," << endl
+         << "  \"repeat\": " << repeat << "," << endl
+         << "  \"seed\": " << seed << "," << endl
+         << "  \"threads\": " << omp_get_max_threads() << "," << endl
+         << "  \"shadow\": \"hard\"," << endl
+         << "  \"ao_rays\": " << AO_RAYS << "," << endl
+         << "  \"mesh_cache\": " << (MeshCache::enabled ? "true" : "false") << "," << endl
+         << "  \"scenes\": [" << endl;
+    bool failed = false;
+    bool first = true;
+    for (const string &name : scenes) {
+        cerr << name << "..." << endl;
+        string result;
+        if (!runSceneInChild(argv[0], name, width, height, repeat, seed, result)) {
+            cerr << "Benchmark of " << name << " failed" << endl;
+            failed = true;
+            continue;
+        }
+        json << (first ? "" : ",\n") << "    " << result;
+        first = false;
+    }
+    json << endl << "  ]" << endl << "}" << endl;
+
+    if (output.empty()) {
+        cout << json.str();
+    }
+    else {
+        ofstream file(output.c_str());
+        file << json.str();
+        if (!file) {
+            cerr << "Cannot write " << output << endl;
+            return 1;
+        }
+    }
+
+    if (!baseline.empty()) {
+        ifstream file(baseline.c_str());
+        if (!file) {
+            cerr << "Cannot read " << baseline << endl;
+            return 1;
+        }
+        stringstream ss;
+        ss << file.rdbuf();
+        const map<string, double> before = readField(ss.str(), "render_ms");
+        const map<string, double> after = readField(json.str(), "render_ms");
+        cerr << endl << "scene       baseline ms   current ms   speedup" << endl;
+        for (const auto &a : after) {
+            auto b = before.find(a.first);
+            if (b == before.end() || a.second <= 0) {
+                continue;
+            }
+            const double speedup = b->second/a.second;
+            fprintf(stderr, "%-10s %12.1f %12.1f %9.3f%s\n", a.first.c_str(), b->second, a.second,
+                    speedup, speedup < 1.f/(1.f+tolerance) ? "  SLOWER" : "");
+            failed |= speedup < 1.f/(1.f+tolerance);
+        }
+    }
+
+    return failed ? 2 : 0;
+}
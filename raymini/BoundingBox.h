@@ -143,7 +143,6 @@ public:
         right.minBb[i] = cut;
     }
     bool intersectRay (const Vec3Df & origin, const Vec3Df & direction, Vec3Df & intersection) const;
-
     inline float getMiddle (unsigned int i) const {
         return ((minBb[i] + maxBb[i]) / 2.0);
     }
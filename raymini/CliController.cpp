@@ -0,0 +1,54 @@
+#include <iostream>
+#include <iomanip>
+
+#include "CliController.h"
+
+using namespace std;
+
+CliController::CliController():
+    scene(nullptr),
+    rayTracer(nullptr),
+    pbgi(nullptr),
+    focusPoint(Vec3Df(), Vec3Df(0, 0, 1))
+{}
+
+CliController::~CliController()
+{
+    delete pbgi;
+    delete rayTracer;
+    delete scene;
+}
+
+void CliController::initAll(int argc, char **argv) {
+    scene = new Scene(this, argc, argv);
+    rayTracer = new RayTracer(this);
+}
+
+void CliController::initPBGI() {
+    // do this after Scene and RayTracer
+    if (!pbgi) {
+        pbgi = new PBGI(this);
+    }
+}
+
+QImage CliController::render(const Vec3Df &camPos, const Vec3Df &target, const Vec3Df &upVector,
+                             float fieldOfView, unsigned width, unsigned height,
+                             vector<TileScheduler::Tile> *tiles) {
+    Vec3Df viewDirection = target - camPos;
+    viewDirection.normalize();
+    Vec3Df rightVector = Vec3Df::crossProduct(viewDirection, upVector);
+    rightVector.normalize();
+    Vec3Df up = Vec3Df::crossProduct(rightVector, viewDirection);
+    up.normalize();
+
+    return rayTracer->render(camPos, viewDirection, up, rightVector,
+                             fieldOfView*M_PI/180.f, float(width)/float(height),
+                             width, height, tiles);
+}
+
+void CliController::renderProgressed(float percent) {
+    cerr << '\r' << fixed << setprecision(1) << setw(5) << percent << "%";
+    if (percent >= 100) {
+        cerr << endl;
+    }
+}
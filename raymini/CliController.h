@@ -0,0 +1,56 @@
+/**
+ * Drive the rendering core without any window, for batch renders
+ */
+
+#pragma once
+
+#include <QImage>
+#include <vector>
+
+#include "BaseController.h"
+#include "Scene.h"
+#include "RayTracer.h"
+#include "PBGI.h"
+
+class CliController : public BaseController {
+    Q_OBJECT
+public:
+    CliController();
+    virtual ~CliController();
+
+    /** Load the scene, argv is the one the GUI takes: <program> <scene> [<mesh>] */
+    void initAll(int argc, char **argv);
+
+    /** Build the point cloud, needed before rendering in PBGI_MODE */
+    void initPBGI();
+
+    inline const Scene *getScene() {return scene;}
+    inline const RayTracer *getRayTracer() {return rayTracer;}
+    inline const PBGI *getPBGI() {return pbgi;}
+
+    /** There is no view to modify the ray tracer, set it up from here */
+    inline RayTracer *getEditableRayTracer() {return rayTracer;}
+
+    inline bool isRealTime() {return false;}
+    inline Vertex getFocusPoint() {return focusPoint;}
+    inline void setFocusPoint(const Vertex &v) {focusPoint = v;}
+    inline bool isEmergencyStop() {return false;}
+
+    /**
+     * Render from camPos towards target, with the camera frame of the viewer
+     * fieldOfView is in degrees
+     */
+    QImage render(const Vec3Df &camPos, const Vec3Df &target, const Vec3Df &upVector,
+                  float fieldOfView, unsigned width, unsigned height,
+                  std::vector<TileScheduler::Tile> *tiles = nullptr);
+
+public slots:
+    /** Print the progression on the standard error */
+    void renderProgressed(float);
+
+private:
+    Scene *scene;
+    RayTracer *rayTracer;
+    PBGI *pbgi;
+    Vertex focusPoint;
+};
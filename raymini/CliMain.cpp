@@ -0,0 +1,233 @@
+#include <QCoreApplication>
+#include <QImage>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "CliController.h"
+
+using namespace std;
+
+static void printCliUsage(const char *name) {
+    cerr << endl
+         << "Render a scene without any window: " << name << " <scene> [<mesh_path>] [options]" << endl
+         << "Scenes are the ones of raymini, options are:" << endl
+         << "\t-o <file>: output picture (render.png)" << endl
+         << "\t--size <width>x<height>: picture size (800x600)" << endl
+         << "\t--camera <x,y,z>: camera position (0,0,5)" << endl
+         << "\t--target <x,y,z>: point looked at (0,0,0)" << endl
+         << "\t--up <x,y,z>: up vector (0,0,1)" << endl
+         << "\t--fov <degrees>: vertical field of view (45)" << endl
+         << "\t--focus <x,y,z>: focus point, for depth of field (target)" << endl
+         << "\t--mode <pt|pbgi>: path tracing or point based global illumination (pt)" << endl
+         << "\t--quality <optimal|basic|N>: full, basic or one pixel over N (optimal)" << endl
+         << "\t--aa <none|uniform|polygonal|stochastic> <rays>: anti aliasing (none)" << endl
+         << "\t--ao <rays> <radius>: ambient occlusion (0 rays)" << endl
+         << "\t--shadow <none|hard|soft> <rays>: shadows (none)" << endl
+         << "\t--pt <depth> <rays>: path tracing (0 depth)" << endl
+         << "\t--dof <none|uniform|stochastic> <rays> <aperture>: depth of field (none)" << endl
+         << "\t--pictures <N>: time samples per pixel when objects move (1)" << endl
+         << "\t--error <error> <passes>: add one ray per pixel and pass until the noise of" << endl
+         << "\t\tthe picture is below error, with at most passes passes (one pass)" << endl
+         << "\t--adaptive <error>: stop anti aliasing a pixel once its noise is below error (0)" << endl
+         << "\t--density <file>: also write the number of samples of each pixel" << endl
+         << "\t--seed <N>: random seed, the same seed gives the same picture (0)" << endl
+         << "\t--sampler <random|sobol>: random numbers of the samples of a pixel (sobol)" << endl
+         << endl;
+    exit(1);
+}
+
+static Vec3Df parseVec(const char *s) {
+    Vec3Df v;
+    if (sscanf(s, "%f,%f,%f", &v[0], &v[1], &v[2]) != 3) {
+        cerr << "Invalid vector: " << s << endl;
+        exit(1);
+    }
+    return v;
+}
+
+static unsigned parseIndex(const string &s, const vector<string> &names) {
+    auto it = find(names.begin(), names.end(), s);
+    if (it == names.end()) {
+        cerr << "Invalid value: " << s << endl;
+        exit(1);
+    }
+    return it - names.begin();
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication raymini(argc, argv);
+
+    if (argc < 2 || argv[1][0] == '-') {
+        printCliUsage(argv[0]);
+    }
+    // The scene takes the same arguments as the GUI
+    int sceneArgc = 2;
+    char *sceneArgv[3] = {argv[0], argv[1], nullptr};
+    int a = 2;
+    if (argc > 2 && argv[2][0] != '-') {
+        sceneArgv[2] = argv[2];
+        sceneArgc = 3;
+        a = 3;
+    }
+
+    CliController controller;
+    auto start = chrono::steady_clock::now();
+    controller.initAll(sceneArgc, sceneArgv);
+    RayTracer *rayTracer = controller.getEditableRayTracer();
+    auto loaded = chrono::steady_clock::now();
+
+    string output("render.png");
+    unsigned width = 800, height = 600;
+    Vec3Df camPos(0, 0, 5), target, upVector(0, 0, 1);
+    float fieldOfView = 45;
+    bool focusSet = false;
+    float targetError = 0;
+    unsigned maxPasses = 1;
+    string densityOutput;
+
+    auto next = [&]() -> const char * {
+        if (a+1 >= argc) {
+            printCliUsage(argv[0]);
+        }
+        return argv[++a];
+    };
+    for (; a < argc; a++) {
+        string opt(argv[a]);
+        if (opt == "-o") {
+            output = next();
+        }
+        else if (opt == "--size") {
+            if (sscanf(next(), "%ux%u", &width, &height) != 2 || !width || !height) {
+                printCliUsage(argv[0]);
+            }
+        }
+        else if (opt == "--camera") camPos = parseVec(next());
+        else if (opt == "--target") target = parseVec(next());
+        else if (opt == "--up") upVector = parseVec(next());
+        else if (opt == "--fov") fieldOfView = atof(next());
+        else if (opt == "--focus") {
+            controller.setFocusPoint(Vertex(parseVec(next()), Vec3Df(0, 0, 1)));
+            focusSet = true;
+        }
+        else if (opt == "--mode") {
+            rayTracer->setMode(RayTracer::Mode(parseIndex(next(), {"pt", "pbgi"})));
+        }
+        else if (opt == "--quality") {
+            string q(next());
+            if (q == "optimal") rayTracer->setQuality(RayTracer::OPTIMAL);
+            else if (q == "basic") rayTracer->setQuality(RayTracer::BASIC);
+            else {
+                rayTracer->setQuality(RayTracer::ONE_OVER_X);
+                rayTracer->setQualityDivider(max(atoi(q.c_str()), 1));
+            }
+        }
+        else if (opt == "--aa") {
+            rayTracer->setTypeAntiAliasing(AntiAliasing::Type(parseIndex(next(),
+                {"none", "uniform", "polygonal", "stochastic"})));
+            rayTracer->setNbRayAntiAliasing(atoi(next()));
+        }
+        else if (opt == "--ao") {
+            rayTracer->setNbRayAmbientOcclusion(atoi(next()));
+            rayTracer->setRadiusAmbientOcclusion(atof(next()));
+        }
+        else if (opt == "--shadow") {
+            rayTracer->setShadowMode(Shadow::Mode(parseIndex(next(), {"none", "hard", "soft"})));
+            rayTracer->setShadowNbImpulse(atoi(next()));
+        }
+        else if (opt == "--pt") {
+            rayTracer->setDepthPathTracing(atoi(next()));
+            rayTracer->setNbRayPathTracing(atoi(next()));
+        }
+        else if (opt == "--dof") {
+            rayTracer->setTypeFocus(Focus::Type(parseIndex(next(), {"none", "uniform", "stochastic"})));
+            rayTracer->setNbRayFocus(atoi(next()));
+            rayTracer->setApertureFocus(atof(next()));
+        }
+        else if (opt == "--pictures") rayTracer->setNbPictures(max(atoi(next()), 1));
+        else if (opt == "--error") {
+            targetError = atof(next());
+            maxPasses = max(atoi(next()), 1);
+            rayTracer->setProgressive(true);
+        }
+        else if (opt == "--adaptive") rayTracer->setAdaptiveError(max(float(atof(next())), 0.f));
+        else if (opt == "--density") densityOutput = next();
+        else if (opt == "--seed") rayTracer->setSeed(strtoul(next(), nullptr, 10));
+        else if (opt == "--sampler") {
+            rayTracer->setSamplerType(Sampler::Type(parseIndex(next(), {"random", "sobol"})));
+        }
+        else printCliUsage(argv[0]);
+    }
+
+    if (!focusSet) {
+        controller.setFocusPoint(Vertex(target, Vec3Df(0, 0, 1)));
+    }
+    if (rayTracer->getMode() == RayTracer::PBGI_MODE) {
+        controller.initPBGI();
+    }
+
+    auto prepared = chrono::steady_clock::now();
+    vector<TileScheduler::Tile> tiles;
+    unsigned long long nbRays[RayTracer::NB_RAY_TYPES] = {0};
+    QImage image;
+    unsigned nbPasses = 0;
+    do {
+        image = controller.render(camPos, target, upVector, fieldOfView, width, height, &tiles);
+        for (unsigned t = 0; t < RayTracer::NB_RAY_TYPES; t++) {
+            nbRays[t] += rayTracer->getNbRays(RayTracer::RayType(t));
+        }
+        nbPasses++;
+    } while (nbPasses < maxPasses && rayTracer->getFilm().getError() > targetError);
+    auto rendered = chrono::steady_clock::now();
+
+    if (!image.save(QString(output.c_str()))) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    if (!densityOutput.empty() && !rayTracer->getSampleDensity().save(QString(densityOutput.c_str()))) {
+        cerr << "Cannot write " << densityOutput << endl;
+        return 1;
+    }
+
+    auto ms = [](chrono::steady_clock::duration d) {
+        return chrono::duration<float, milli>(d).count();
+    };
+    float minTile = 0, maxTile = 0, sumTile = 0;
+    for (const TileScheduler::Tile &t : tiles) {
+        minTile = (&t == &tiles[0]) ? t.time : min(minTile, t.time);
+        maxTile = max(maxTile, t.time);
+        sumTile += t.time;
+    }
+    KDtree::Stats trees = KDtree::Stats();
+    for (const Object *o : controller.getScene()->getObjects()) {
+        const KDtree::Stats &stats = o->getKDtree().getStats();
+        trees.buildTime += stats.buildTime;
+        trees.nbNodes += stats.nbNodes;
+        trees.nbLeaves += stats.nbLeaves;
+        trees.nbReferences += stats.nbReferences;
+        trees.maxDepth = max(trees.maxDepth, stats.maxDepth);
+    }
+    cout << "Scene loaded in " << ms(loaded-start) << " ms" << endl
+         << "KDtrees built in " << trees.buildTime << " ms: "
+         << trees.nbNodes << " nodes, " << trees.nbLeaves << " leaves, "
+         << trees.nbReferences << " triangle references, depth " << trees.maxDepth << endl
+         << "Prepared in " << ms(prepared-loaded) << " ms" << endl
+         << "Rendered " << width << "x" << height << " in " << ms(rendered-prepared) << " ms";
+    if (rayTracer->isProgressive()) {
+        cout << ", " << nbPasses << " passes, error " << rayTracer->getFilm().getError();
+    }
+    cout << endl
+         << "Tiles: " << tiles.size()
+         << ", min " << minTile << " ms"
+         << ", mean " << (tiles.empty() ? 0 : sumTile/tiles.size()) << " ms"
+         << ", max " << maxTile << " ms" << endl
+         << "Rays: " << nbRays[RayTracer::PRIMARY_RAY] << " primary, "
+         << nbRays[RayTracer::SHADOW_RAY] << " shadow, "
+         << nbRays[RayTracer::SECONDARY_RAY] << " secondary" << endl
+         << "Saved " << output << endl;
+
+    return 0;
+}
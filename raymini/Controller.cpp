@@ -58,6 +58,9 @@ void Controller::initAll(int argc, char **argv) {
 }
 
 void Controller::notifyAll() {
+    if (scene->isChanged(Scene::OBJECT_CHANGED)) {
+        scene->updateBVH();
+    }
     for (Observable *m : models) {
         m->notifyAll();
     }
@@ -270,6 +273,13 @@ void Controller::windowSetNbRayAntiAliasing(int i) {
     notifyAll();
 }
 
+void Controller::windowSetAdaptiveError(double e) {
+    ensureThreadStopped();
+    rayTracer->setAdaptiveError(e);
+    renderThread->hasToRedraw();
+    notifyAll();
+}
+
 void Controller::windowChangeAmbientOcclusionNbRays(int index) {
     ensureThreadStopped();
     rayTracer->setNbRayAmbientOcclusion(index);
@@ -393,6 +403,13 @@ void Controller::windowSetIntensityPathTracing(double i) {
     notifyAll();
 }
 
+void Controller::windowSetIntensityPBGI(double i) {
+    ensureThreadStopped();
+    rayTracer->setIntensityPBGI(i);
+    renderThread->hasToRedraw();
+    notifyAll();
+}
+
 void Controller::windowSetNbImagesSpinBox(int i) {
     ensureThreadStopped();
     rayTracer->setNbPictures(i);
@@ -762,6 +779,8 @@ void Controller::windowEnableObject(bool enabled) {
 }
 
 void Controller::windowSetObjectName(const QString &n) {
+    // OBJECT_CHANGED refreshes the object lists, but also refits the BVH
+    ensureThreadStopped();
     int o = windowModel->getSelectedObjectIndex();
     if (o == -1) {
         cerr << __FUNCTION__ << " called even though an object hasn't been selected!\n";
@@ -1034,6 +1053,7 @@ void Controller::windowSetUScale(double u) {
         return;
     }
     scene->getObjects()[o]->getMesh().setUScale(u);
+    scene->getObjects()[o]->updateRenderMesh();
     scene->setChanged(Scene::OBJECT_CHANGED);
     renderThread->hasToRedraw();
     notifyAll();
@@ -1047,6 +1067,7 @@ void Controller::windowSetVScale(double v) {
         return;
     }
     scene->getObjects()[o]->getMesh().setVScale(v);
+    scene->getObjects()[o]->updateRenderMesh();
     scene->setChanged(Scene::OBJECT_CHANGED);
     renderThread->hasToRedraw();
     notifyAll();
@@ -1060,6 +1081,7 @@ void Controller::windowSetSquareMapping() {
         return;
     }
     scene->getObjects()[o]->getMesh().setSquareTextureMapping();
+    scene->getObjects()[o]->updateRenderMesh();
     scene->setChanged(Scene::OBJECT_CHANGED);
     renderThread->hasToRedraw();
     notifyAll();
@@ -1073,6 +1095,7 @@ void Controller::windowSetSphericalMapping() {
         return;
     }
     scene->getObjects()[o]->getMesh().setDefaultTextureMapping();
+    scene->getObjects()[o]->updateRenderMesh();
     scene->setChanged(Scene::OBJECT_CHANGED);
     renderThread->hasToRedraw();
     notifyAll();
@@ -1087,6 +1110,7 @@ void Controller::windowSetCubicMapping() {
     }
     Object *o = scene->getObjects()[io];
     o->getMesh().setCubeTextureMapping(&o->getMaterial(), 3, 3);
+    o->updateRenderMesh();
     scene->setChanged(Scene::OBJECT_CHANGED);
     renderThread->hasToRedraw();
     notifyAll();
@@ -1102,10 +1126,10 @@ void Controller::windowMeshLoadOff() {
     QString filename = QFileDialog::getOpenFileName(window,
                                                     "Open a mesh file",
                                                     "./models",
-                                                    "*.off");
+                                                    "Meshes (*.off *.ply *.obj)");
     if (!filename.isNull()) {
         Object *o = scene->getObjects()[io];
-        o->getMesh().loadOFF(filename.toStdString().c_str());
+        o->getMesh().load(filename.toStdString().c_str());
         o->updateKDtree();
         scene->setChanged(Scene::OBJECT_CHANGED);
         renderThread->hasToRedraw();
@@ -1193,6 +1217,7 @@ void Controller::viewerStartsDragging(Object *o, Vec3Df i, QPoint p, float r) {
 }
 
 void Controller::viewerMovesWhileDragging(QPoint p) {
+    ensureThreadStopped();
     float fov, ar, screenWidth, screenHeight;
     Vec3Df camPos;
     Vec3Df viewDirection;
@@ -1220,10 +1245,3 @@ void Controller::setRayTracerQuality(RayTracer::Quality quality) {
     rayTracer->setQuality(quality);
 }
 
-void Controller::setSceneMove(int nbPictures) {
-    scene->move(nbPictures);
-}
-
-void Controller::setSceneReset() {
-    scene->reset();
-}
@@ -13,8 +13,9 @@
 #include "Scene.h"
 #include "GLViewer.h"
 #include "PBGI.h"
+#include "BaseController.h"
 
-class Controller : public QObject {
+class Controller : public BaseController {
     Q_OBJECT
 public:
     Controller(QApplication *r);
@@ -33,6 +34,10 @@ public:
     inline const WindowModel *getWindowModel() {return windowModel;}
     inline const RenderThread *getRenderThread() {return renderThread;}
 
+    inline bool isRealTime() {return windowModel->isRealTime();}
+    inline Vertex getFocusPoint() {return windowModel->getFocusPoint();}
+    inline bool isEmergencyStop() {return renderThread->isEmergencyStop();}
+
     /** To use with caution */
     inline void forceThreadUpdate() {
         if (renderThread->isReallyWorking()) {
@@ -53,6 +58,7 @@ public slots :
     void windowAbout();
     void windowChangeAntiAliasingType(int index);
     void windowSetNbRayAntiAliasing(int);
+    void windowSetAdaptiveError(double);
     void windowChangeAmbientOcclusionNbRays(int index);
     void windowSetAmbientOcclusionMaxAngle(int);
     void windowSetAmbientOcclusionRadius(double);
@@ -66,6 +72,7 @@ public slots :
     void windowSetDepthPathTracing(int);
     void windowSetNbRayPathTracing(int);
     void windowSetIntensityPathTracing(double);
+    void windowSetIntensityPBGI(double);
     void windowSetOnlyPT(bool);
     void windowSetNbImagesSpinBox(int);
     void windowSelectLight(int);
@@ -155,8 +162,6 @@ public:
 
     // Won't notify ****
     void setRayTracerQuality(RayTracer::Quality quality);
-    void setSceneMove(int nbPictures);
-    void setSceneReset();
     // *****************
 
     /**
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Film.h"
+
+using namespace std;
+
+void Film::reset(unsigned width, unsigned height) {
+    this->width = width;
+    this->height = height;
+    pixels.assign(width*height, Pixel());
+}
+
+Vec3Df Film::getVariance(unsigned i, unsigned j) const {
+    const Pixel &p = pixels[j*width+i];
+    if (p.nbSamples < 2) {
+        return Vec3Df();
+    }
+    return p.m2/float(p.nbSamples-1);
+}
+
+float Film::getError(unsigned i, unsigned j) const {
+    const unsigned n = getNbSamples(i, j);
+    if (n < 2) {
+        return numeric_limits<float>::infinity();
+    }
+    const Vec3Df variance = getVariance(i, j);
+    return sqrt((variance[0] + variance[1] + variance[2])/(3.f*n));
+}
+
+float Film::getError() const {
+    if (pixels.empty() || getMinNbSamples() < 2) {
+        return numeric_limits<float>::infinity();
+    }
+    double sum = 0;
+    #pragma omp parallel for reduction(+:sum)
+    for (unsigned j = 0; j < height; j++) {
+        for (unsigned i = 0; i < width; i++) {
+            const float e = getError(i, j);
+            sum += e*e;
+        }
+    }
+    return sqrt(sum/pixels.size());
+}
+
+unsigned Film::getMinNbSamples() const {
+    unsigned n = numeric_limits<unsigned>::max();
+    for (const Pixel &p : pixels) {
+        n = min(n, p.nbSamples);
+    }
+    return pixels.empty() ? 0 : n;
+}
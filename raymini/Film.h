@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "Vec3D.h"
+
+/**
+ * Progressive accumulation buffer of a picture
+ *
+ * Every pixel keeps its number of samples, their running mean and the sum
+ * of their squared differences to it (Welford), so that samples can be
+ * added pass after pass, even by interrupted passes, and the remaining
+ * noise of each pixel is known.
+ * Different pixels can be updated by different threads at the same time.
+ */
+class Film {
+public:
+    Film(): width(0), height(0) {}
+
+    inline unsigned getWidth() const { return width; }
+    inline unsigned getHeight() const { return height; }
+
+    /** Drop every sample, resizing the film if needed */
+    void reset(unsigned width, unsigned height);
+
+    inline void add(unsigned i, unsigned j, const Vec3Df &sample) {
+        Pixel &p = pixels[j*width+i];
+        p.nbSamples++;
+        const Vec3Df delta = sample - p.mean;
+        p.mean += delta/float(p.nbSamples);
+        for (unsigned c = 0; c < 3; c++) {
+            // Rounding can make it slightly negative for nearly constant samples
+            p.m2[c] = std::max(0.f, p.m2[c] + delta[c]*(sample[c] - p.mean[c]));
+        }
+    }
+
+    inline unsigned getNbSamples(unsigned i, unsigned j) const { return pixels[j*width+i].nbSamples; }
+    /** Mean of the samples, black without samples */
+    inline const Vec3Df & getMean(unsigned i, unsigned j) const { return pixels[j*width+i].mean; }
+    /** Unbiased variance of the samples, null under 2 samples */
+    Vec3Df getVariance(unsigned i, unsigned j) const;
+
+    /** Standard error of the mean of a pixel, root mean square over its channels */
+    float getError(unsigned i, unsigned j) const;
+
+    /**
+     * Root mean square of the errors of every pixel, infinite while a pixel
+     * has less than 2 samples: renders can go on until it gets low enough
+     */
+    float getError() const;
+
+    /** Fewest samples of a pixel */
+    unsigned getMinNbSamples() const;
+
+private:
+    class Pixel {
+    public:
+        Pixel(): nbSamples(0) {}
+        Vec3Df mean;
+        Vec3Df m2;
+        unsigned nbSamples;
+    };
+
+    unsigned width, height;
+    std::vector<Pixel> pixels;
+};
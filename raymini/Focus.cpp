@@ -2,6 +2,7 @@
 #include <iostream>
 
 #include "Focus.h"
+#include "Sampler.h"
 
 using namespace std;
 
@@ -30,12 +31,14 @@ vector<pair<float, float>> Focus::generateOffsets(Type type, float aperture, uns
             }
             break;
 
-        case STOCHASTIC:
-                for (unsigned int i=0; i<rays; i++) {
-                    float di = ((float)rand() / (float)RAND_MAX) - aperture/sqrt(2.0);
-                    float dj = ((float)rand() / (float)RAND_MAX) - aperture/sqrt(2.0) ;
-                    offsets.push_back(make_pair(di, dj));
+        case STOCHASTIC: {
+                offsets.resize(rays);
+                Sampler::local().get2D(rays, offsets.data());
+                for (pair<float, float> &offset : offsets) {
+                    offset.first -= aperture/sqrt(2.0);
+                    offset.second -= aperture/sqrt(2.0);
                 }
+            }
             break;
     }
 
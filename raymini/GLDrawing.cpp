@@ -0,0 +1,56 @@
+// OpenGL drawing of rendering classes, only linked in the GUI so that the
+// headless targets need no OpenGL library
+
+#include <GL/glew.h>
+
+#include "Mesh.h"
+#include "Ray.h"
+
+inline void glVertexVec3Df (const Vec3Df & v) {
+    glVertex3f (v[0], v[1], v[2]);
+}
+
+inline void glNormalVec3Df (const Vec3Df & n) {
+    glNormal3f (n[0], n[1], n[2]);
+}
+
+inline void glDrawPoint (const Vec3Df & pos, const Vec3Df & normal) {
+    glNormalVec3Df (normal);
+    glVertexVec3Df (pos);
+}
+
+inline void glDrawPoint (const Vertex & v) {
+    glDrawPoint (v.getPos (), v.getNormal ());
+}
+
+void Mesh::renderGL (bool flat) const {
+    glBegin (GL_TRIANGLES);
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        const Triangle & t = triangles[i];
+        Vertex v[3];
+        for (unsigned int j = 0; j < 3; j++)
+            v[j] = vertices[t.getVertex(j)];
+        if (flat) {
+            Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
+                                                  v[2].getPos () - v[0].getPos ());
+            normal.normalize ();
+            glNormalVec3Df (normal);
+        }
+        for (unsigned int j = 0; j < 3; j++)
+            if (!flat)
+                glDrawPoint (v[j]);
+            else
+                glVertexVec3Df (v[j].getPos ());
+    }
+    glEnd ();
+}
+
+void Ray::draw(float r, float g, float b) {
+    const Vec3Df & origin = ray.origin;
+    const Vec3Df & direction = ray.direction;
+    glColor3f(r, g, b);
+    glBegin(GL_LINES);
+    glVertex3f(origin[0], origin[1], origin[2]);
+    glVertex3f(origin[0]+direction[0], origin[1]+direction[1], origin[2]+direction[2]);
+    glEnd();
+}
@@ -360,9 +360,8 @@ void GLViewer::draw_octree(const Octree * t) {
     drawCube(t->bBox.getMin(), t->bBox.getMax());
 }
 
-bool drawNode(const KDtree *t) {
-    GLViewer::drawCube(t->bBox.getMin(), t->bBox.getMax());
-    return true;
+void drawNode(const BoundingBox &b) {
+    GLViewer::drawCube(b.getMin(), b.getMax());
 }
 
 void GLViewer::draw() {
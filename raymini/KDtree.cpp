@@ -1,110 +1,354 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "KDtree.h"
+#include "KDtreeBuilder.h"
+#include "MeshCache.h"
+#include "RayPacket.h"
 #include "Object.h"
 
 using namespace std;
 
-KDtree::KDtree(Object &o):o(o),
-                                left(nullptr), right(nullptr),
-                                splitAxis(Axis::NONE),
-                                bBox(o.getBoundingBox()) {
-    const Mesh & mesh = o.getMesh();
-    triangles.resize(mesh.getTriangles().size());
-    for(unsigned int i = 0 ; i < mesh.getTriangles().size() ; i++)
-        triangles[i] = i;
-    next();
+KDtree::Split KDtree::defaultSplit = KDtree::SAH;
+
+KDtree::KDtree(Object &o, Split split):
+    bBox(o.getBoundingBox()),
+    o(o) {
+    auto start = chrono::steady_clock::now();
+    stats = Stats();
+    const string & cachePath = o.getMesh().getCachePath();
+    const uint64_t hash = cachePath.empty() ? 0 : MeshCache::hashGeometry(o.getMesh());
+    if(cachePath.empty() || !MeshCache::loadKDtree(cachePath, hash, split, nodes, triangles, stats)) {
+        {
+            KDtreeBuilder builder(o.getMesh(), bBox, split);
+            flatten(&builder.getRoot(), 0);
+        }
+        stats.nbNodes = nodes.size();
+        if(!cachePath.empty())
+            MeshCache::saveKDtree(cachePath, hash, split, nodes, triangles, stats);
+    }
+    // Traversals push at most one node per level, see KDtreeBuilder::maxDepth,
+    // cached trees deeper than that are rejected by MeshCache::loadKDtree
+    assert(stats.maxDepth < MAX_DEPTH);
+    stats.buildTime = chrono::duration<float, milli>(chrono::steady_clock::now()-start).count();
 }
 
-void KDtree::next() {
-    if(triangles.size() <= MIN_TRIANGLES) return;//leaf
+unsigned KDtree::flatten(const KDtreeBuilderNode *b, unsigned depth) {
+    unsigned index = nodes.size();
+    nodes.push_back(Node());
+    stats.maxDepth = max(stats.maxDepth, depth);
+
+    if(b->isLeaf()) {
+        nodes[index].initLeaf(triangles.size(), b->nbTriangles);
+        for(unsigned i = 0 ; i < b->nbTriangles ; i++) {
+            if(i % PackedTriangles::WIDTH == 0)
+                triangles.push_back(PackedTriangles());
+            triangles.back().set(i % PackedTriangles::WIDTH, o.getRenderMesh(), b->triangles[i]);
+        }
+        stats.nbLeaves++;
+        stats.nbReferences += b->nbTriangles;
+    }
+    else {
+        flatten(b->left, depth+1);
+        unsigned above = flatten(b->right, depth+1);
+        nodes[index].initInterior(b->splitAxis, b->cut, above);
+    }
+    return index;
+}
 
-    findSplitAxis();
-    float med = bBox.getMiddle(splitAxis);
+void KDtree::exec(void (*f)(const BoundingBox &)) const {
+    if(!nodes.empty())
+        exec(f, 0, bBox);
+}
 
+void KDtree::exec(void (*f)(const BoundingBox &), unsigned node, const BoundingBox & box) const {
+    f(box);
+    const Node & n = nodes[node];
+    if(n.isLeaf()) return;
     BoundingBox lb, rb;
-    bBox.split(med, splitAxis, lb, rb);
+    box.split(n.getSplit(), n.getAxis(), lb, rb);
+    exec(f, node+1, lb);
+    exec(f, n.getAboveChild(), rb);
+}
 
-    vector<unsigned> lt, rt;
-    splitTriangles(lb, rb, lt, rt);
+bool KDtree::intersect(const BasicRay &ray, Hit &hit) const {
+    if(nodes.empty()) return hit.found();
 
-    triangles.clear();//not a leaf
+    // Flat boxes (planes) would be missed without a little padding
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+    float tMin = 0.f, tMax = 1e30f;
+    if(!ray.clip(BoundingBox(bBox.getMin()-pad, bBox.getMax()+pad), tMin, tMax))
+        return hit.found();
 
-    left = new KDtree(o, lt, lb);
-    right = new KDtree(o, rt, rb);
+    return traverse(ray, hit, 0, tMin, tMax);
 }
 
-void KDtree::findSplitAxis() {
-    Vec3Df delta = bBox.getMax()-bBox.getMin();
+bool KDtree::traverse(const BasicRay &ray, Hit &hit, unsigned node, float tMin, float tMax) const {
+    const Vec3Df & origin = ray.origin;
+    const Vec3Df & dir = ray.direction;
+    const Vec3Df & invDir = ray.invDirection;
+    // Ray keeps squared distances, compare them with t^2 |dir|^2
+    const float dirLength2 = dir.getSquaredLength();
 
-    if(delta[0] <= delta[1]) {
-        if(delta[1] <= delta[2])
-            splitAxis = Axis::Z;
-        else
-            splitAxis = Axis::Y;
-    }
-    else {
-        if(delta[0] <= delta[2])
-            splitAxis = Axis::Z;
-        else
-            splitAxis = Axis::X;
+    struct ToDo {
+        unsigned node;
+        float tMin, tMax;
+    } todo[MAX_DEPTH];
+    unsigned todoPos = 0;
+
+    while(true) {
+        // Closest hit is before this node: done
+        if(hit.distance < tMin*tMin*dirLength2)
+            break;
+
+        const Node & n = nodes[node];
+        if(!n.isLeaf()) {
+            const unsigned axis = n.getAxis();
+            const float split = n.getSplit();
+            const float tPlane = (split - origin[axis]) * invDir[axis];
+
+            const bool belowFirst = (origin[axis] < split) ||
+                (origin[axis] == split && dir[axis] <= 0);
+            const unsigned first = belowFirst ? node+1 : n.getAboveChild();
+            const unsigned second = belowFirst ? n.getAboveChild() : node+1;
+
+            if(tPlane > tMax || tPlane <= 0)
+                node = first;
+            else if(tPlane < tMin)
+                node = second;
+            else {
+                todo[todoPos++] = {second, tPlane, tMax};
+                tMax = tPlane;
+                node = first;
+            }
+        }
+        else {
+            const unsigned end = n.getFirstTriangle() + n.getNbPackets();
+            for(unsigned i = n.getFirstTriangle() ; i < end ; i++)
+                ray.intersect(triangles[i], &o, hit);
+
+            if(!todoPos) break;
+            todoPos--;
+            node = todo[todoPos].node;
+            tMin = todo[todoPos].tMin;
+            tMax = todo[todoPos].tMax;
+        }
     }
+
+    return hit.found();
 }
 
-void KDtree::splitTriangles(const BoundingBox & lb, const BoundingBox & rb,
-                            std::vector<unsigned> &left, std::vector<unsigned> &right) const {
-    const Mesh & mesh = o.getMesh();
-    for(unsigned t : triangles) {
-        bool isInLeft = false;
-        bool isInRight = false;
-
-        for(unsigned i = 0 ; i<3 ; i++) {
-            unsigned v = mesh.getTriangles()[t].getVertex(i);
-            const Vec3Df & p = mesh.getVertices()[v].getPos();
-            if(lb.contains(p))
-                isInLeft = true;
-            else if(rb.contains(p))
-                isInRight = true;
+bool KDtree::occluded(const BasicRay &ray, float tMax) const {
+    if(nodes.empty()) return false;
+
+    const Vec3Df & origin = ray.origin;
+    const Vec3Df & dir = ray.direction;
+    const Vec3Df & invDir = ray.invDirection;
+
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+    float tMin = 0.f;
+    if(!ray.clip(BoundingBox(bBox.getMin()-pad, bBox.getMax()+pad), tMin, tMax))
+        return false;
+
+    struct ToDo {
+        unsigned node;
+        float tMin, tMax;
+    } todo[MAX_DEPTH];
+    unsigned todoPos = 0;
+
+    // Same walk as traverse, stopping at the first hit
+    unsigned node = 0;
+    const float maxDistance = tMax;
+    while(true) {
+        const Node & n = nodes[node];
+        if(!n.isLeaf()) {
+            const unsigned axis = n.getAxis();
+            const float split = n.getSplit();
+            const float tPlane = (split - origin[axis]) * invDir[axis];
+
+            const bool belowFirst = (origin[axis] < split) ||
+                (origin[axis] == split && dir[axis] <= 0);
+            const unsigned first = belowFirst ? node+1 : n.getAboveChild();
+            const unsigned second = belowFirst ? n.getAboveChild() : node+1;
+
+            if(tPlane > tMax || tPlane <= 0)
+                node = first;
+            else if(tPlane < tMin)
+                node = second;
+            else {
+                todo[todoPos++] = {second, tPlane, tMax};
+                tMax = tPlane;
+                node = first;
+            }
         }
+        else {
+            const unsigned end = n.getFirstTriangle() + n.getNbPackets();
+            for(unsigned i = n.getFirstTriangle() ; i < end ; i++)
+                if(ray.occluded(triangles[i], maxDistance))
+                    return true;
 
-        if(isInLeft)
-            left.push_back(t);
-        if(isInRight)
-            right.push_back(t);
+            if(!todoPos) break;
+            todoPos--;
+            node = todo[todoPos].node;
+            tMin = todo[todoPos].tMin;
+            tMax = todo[todoPos].tMax;
+        }
     }
+
+    return false;
 }
 
-bool KDtree::intersect(Ray &ray) const {
-    const Mesh & mesh = o.getMesh();
+bool KDtree::intersect(RayPacket &packet) const {
+    if(nodes.empty() || !packet.mask) return false;
+
+#ifdef __SSE2__
+    if(BasicRay::useSIMD) {
+        traverse(packet);
+    }
+    else
+#endif
+    {
+        for(unsigned r = 0 ; r < RayPacket::SIZE ; r++)
+            if(packet.isActive(r))
+                intersect(packet.rays[r]);
+    }
+
+    bool hit = false;
+    for(unsigned r = 0 ; r < RayPacket::SIZE ; r++)
+        hit |= packet.isActive(r) && packet.rays[r].intersect();
+    return hit;
+}
 
-    if(splitAxis ==  Axis::NONE) {
-        for(unsigned idT : triangles) {
-            const Triangle & t = mesh.getTriangles()[idT];
-            const Vertex & v0 = mesh.getVertices() [t.getVertex(0)];
-            const Vertex & v1 = mesh.getVertices() [t.getVertex(1)];
-            const Vertex & v2 = mesh.getVertices() [t.getVertex(2)];
+#ifdef __SSE2__
+void KDtree::traverse(RayPacket &packet) const {
+    // Rays are processed by groups of 4, one per SSE lane
+    static const unsigned SIZE = RayPacket::SIZE;
+    static const unsigned GROUPS = SIZE/4;
 
-            ray.intersect(t, v0, v1, v2, &o);
+    // Inactive lanes get null origins and directions, masks ignore them
+    float origin[3][SIZE] = {{0.f}}, invDir[3][SIZE] = {{0.f}}, dirLength2[SIZE] = {0.f};
+    float tMin[SIZE], tMax[SIZE], hitDistance[SIZE];
+    unsigned mask = 0;
+
+    const Vec3Df pad(BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON, BOUNDINGBOX_EPSILON);
+    const BoundingBox root(bBox.getMin()-pad, bBox.getMax()+pad);
+    for(unsigned r = 0 ; r < SIZE ; r++) {
+        const Ray & ray = packet.rays[r];
+        tMin[r] = 0.f;
+        tMax[r] = 1e30f;
+        hitDistance[r] = ray.getIntersectionDistance();
+        if(!packet.isActive(r)) continue;
+        const Vec3Df & inv = ray.getBasicRay().invDirection;
+        for(unsigned a = 0 ; a < 3 ; a++) {
+            origin[a][r] = ray.getOrigin()[a];
+            invDir[a][r] = inv[a];
         }
-        return ray.intersect();
+        dirLength2[r] = ray.getDirection().getSquaredLength();
+        if(ray.getBasicRay().clip(root, tMin[r], tMax[r]))
+            mask |= 1u << r;
+    }
+
+    __m128 vMin[GROUPS], vMax[GROUPS];
+    for(unsigned g = 0 ; g < GROUPS ; g++) {
+        vMin[g] = _mm_loadu_ps(tMin+4*g);
+        vMax[g] = _mm_loadu_ps(tMax+4*g);
     }
-    else {
-        Vec3Df lI, rI;
-        bool leftIntersection = ray.intersect(left->bBox, lI);
-        bool rightIntersection = ray.intersect(right->bBox, rI);
 
-        if(leftIntersection && rightIntersection) {
-            KDtree * far;
-            KDtree * near;
+    // Packet is coherent: every ray visits children in the same order
+    const Vec3Df & dir = packet.rays[__builtin_ctz(packet.mask)].getDirection();
 
-            float iDistanceL = Vec3Df::squaredDistance (lI, ray.getOrigin());
-            float iDistanceR = Vec3Df::squaredDistance (rI, ray.getOrigin());
+    struct ToDo {
+        __m128 tMin[GROUPS], tMax[GROUPS];
+        unsigned node;
+        unsigned mask;
+    } todo[MAX_DEPTH];
+    unsigned todoPos = 0;
 
-            far = (iDistanceR > iDistanceL) ? right : left;
-            near = (iDistanceR > iDistanceL) ? left : right;
+    unsigned node = 0;
+    while(true) {
+        // Rays whose closest hit is before this node are done
+        for(unsigned g = 0 ; g < GROUPS ; g++) {
+            const __m128 d = _mm_mul_ps(_mm_mul_ps(vMin[g], vMin[g]), _mm_loadu_ps(dirLength2+4*g));
+            mask &= ~(unsigned(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(hitDistance+4*g), d))) << 4*g);
+        }
 
-            return near->intersect(ray) || far->intersect(ray);
+        const Node & n = nodes[node];
+        if(mask && !(mask & (mask-1))) {
+            // Only one ray left, no need to carry the packet
+            const unsigned r = __builtin_ctz(mask);
+            float rMin[SIZE], rMax[SIZE];
+            for(unsigned g = 0 ; g < GROUPS ; g++) {
+                _mm_storeu_ps(rMin+4*g, vMin[g]);
+                _mm_storeu_ps(rMax+4*g, vMax[g]);
+            }
+            traverse(packet.rays[r].getBasicRay(), packet.rays[r].getHit(), node, rMin[r], rMax[r]);
+            // So that nodes popped later are culled by the hit found here
+            hitDistance[r] = packet.rays[r].getHit().distance;
         }
+        else if(mask && !n.isLeaf()) {
+            const unsigned axis = n.getAxis();
+            const __m128 split = _mm_set1_ps(n.getSplit());
+            const unsigned first = dir[axis] > 0 ? node+1 : n.getAboveChild();
+            const unsigned second = dir[axis] > 0 ? n.getAboveChild() : node+1;
+
+            __m128 tPlane[GROUPS];
+            unsigned firstMask = 0, secondMask = 0;
+            for(unsigned g = 0 ; g < GROUPS ; g++) {
+                tPlane[g] = _mm_mul_ps(_mm_sub_ps(split, _mm_loadu_ps(origin[axis]+4*g)),
+                                       _mm_loadu_ps(invDir[axis]+4*g));
+                firstMask |= unsigned(_mm_movemask_ps(_mm_cmple_ps(vMin[g], tPlane[g]))) << 4*g;
+                secondMask |= unsigned(_mm_movemask_ps(_mm_cmple_ps(tPlane[g], vMax[g]))) << 4*g;
+            }
+            firstMask &= mask;
+            secondMask &= mask;
 
-        return (leftIntersection && left->intersect(ray)) || (rightIntersection && right->intersect(ray));
+            if(firstMask && secondMask) {
+                ToDo & t = todo[todoPos++];
+                t.node = second;
+                t.mask = secondMask;
+                for(unsigned g = 0 ; g < GROUPS ; g++) {
+                    t.tMin[g] = _mm_max_ps(vMin[g], tPlane[g]);
+                    t.tMax[g] = vMax[g];
+                }
+            }
+            if(firstMask) {
+                for(unsigned g = 0 ; g < GROUPS ; g++)
+                    vMax[g] = _mm_min_ps(vMax[g], tPlane[g]);
+                mask = firstMask;
+                node = first;
+            }
+            else {
+                for(unsigned g = 0 ; g < GROUPS ; g++)
+                    vMin[g] = _mm_max_ps(vMin[g], tPlane[g]);
+                mask = secondMask;
+                node = second;
+            }
+            continue;
+        }
+        else if(mask) {
+            const unsigned end = n.getFirstTriangle() + n.getNbPackets();
+            for(unsigned r = 0 ; r < SIZE ; r++) {
+                if(!(mask & (1u << r))) continue;
+                const BasicRay & ray = packet.rays[r].getBasicRay();
+                Hit & hit = packet.rays[r].getHit();
+                for(unsigned i = n.getFirstTriangle() ; i < end ; i++)
+                    ray.intersect(triangles[i], &o, hit);
+                hitDistance[r] = hit.distance;
+            }
+        }
+
+        if(!todoPos) break;
+        todoPos--;
+        node = todo[todoPos].node;
+        mask = todo[todoPos].mask;
+        for(unsigned g = 0 ; g < GROUPS ; g++) {
+            vMin[g] = todo[todoPos].tMin[g];
+            vMax[g] = todo[todoPos].tMax[g];
+        }
     }
 }
-
+#endif
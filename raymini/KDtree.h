@@ -4,74 +4,126 @@
 
 #include "BoundingBox.h"
 #include "Ray.h"
+#include "PackedTriangle.h"
 
 class Object;
+class KDtreeBuilderNode;
+class RayPacket;
 
 enum Axis {X = 0, Y = 1, Z = 2, NONE = -1};
 
+/**
+ * Compact kd-tree
+ *
+ * Built with a KDtreeBuilder, then flattened in depth first order:
+ * the child below the split plane immediately follows its parent,
+ * the child above is referenced by index.
+ * Leaves reference a range of one contiguous array of triangle packets,
+ * stored in leaf order (triangles shared by several leaves are duplicated),
+ * each leaf starting a new packet.
+ */
 class KDtree {
-protected:
-    Object &o;
-    std::vector<unsigned> triangles;// sth only if leaf;
-    KDtree *left, *right;
-    Axis splitAxis;
-
 public:
-    static const unsigned MIN_TRIANGLES = 20;
-    const BoundingBox bBox;
+    /**
+     * Split strategy
+     * MEDIAN: cut the longest axis in its middle until MIN_TRIANGLES is reached
+     * SAH: binned surface area heuristic, stops when splitting costs more than a leaf
+     */
+    enum Split {MEDIAN = 0, SAH};
 
-    KDtree(Object &o);
-
-    ~KDtree() {
-        delete left;
-        delete right;
-    }
-
-    Axis getSplitAxis() const { return splitAxis; };
-    std::tuple<const KDtree*, const KDtree*> getSons() const {
-        return std::make_tuple(left, right);
-    }
-    const KDtree* getLeft() const { return left; }
-    const KDtree* getRight() const { return right; }
-    const std::vector<unsigned> &  getTriangles() const { return triangles; }
-
-    bool exec(bool (*f)(const KDtree *)) const {
-        return f(this) && (splitAxis == Axis::NONE ||
-                           (left->exec(f) && right->exec(f)));
-    }
-    void exec(void (*f)(const KDtree *)) const {
-        f(this);
-        if(splitAxis != Axis::NONE) {
-            left->exec(f);
-            right->exec(f);
+    /** Strategy used by the public constructor when none is given */
+    static Split defaultSplit;
+
+    /** 8 bytes node */
+    class Node {
+    public:
+        /** first is a packet index, count a number of triangles */
+        inline void initLeaf(unsigned first, unsigned count) {
+            firstTriangle = first;
+            flags = LEAF | (count << 2);
         }
-    }
-    void execLeaf(void (*f)(const KDtree *)) const {
-        if(splitAxis != Axis::NONE) {
-            left->exec(f);
-            right->exec(f);
+        inline void initInterior(Axis axis, float cut, unsigned aboveChild) {
+            split = cut;
+            flags = unsigned(axis) | (aboveChild << 2);
         }
-        else
-            f(this);
-    }
 
-    bool intersect(Ray &ray) const;
+        inline bool isLeaf() const { return (flags & 3) == LEAF; }
+        inline Axis getAxis() const { return Axis(flags & 3); }
+        inline float getSplit() const { return split; }
+        inline unsigned getAboveChild() const { return flags >> 2; }
+        inline unsigned getFirstTriangle() const { return firstTriangle; }
+        inline unsigned getNbTriangles() const { return flags >> 2; }
+        inline unsigned getNbPackets() const {
+            return (getNbTriangles() + PackedTriangles::WIDTH - 1) / PackedTriangles::WIDTH;
+        }
+
+    private:
+        static const unsigned LEAF = 3;
+        union {
+            float split;            // interior
+            unsigned firstTriangle; // leaf
+        };
+        unsigned flags; // 2 bits: axis or LEAF, 30 bits: above child or triangle count
+    };
+
+    class Stats {
+    public:
+        unsigned nbNodes;
+        unsigned nbLeaves;
+        /** Triangles referenced by leaves, shared ones being counted once per leaf */
+        unsigned nbReferences;
+        unsigned maxDepth;
+        /** Time spent building and flattening the tree, or reading it from the MeshCache, in milliseconds */
+        float buildTime;
+    };
+
+    const BoundingBox bBox;
+
+    KDtree(Object &o, Split split = defaultSplit);
+
+    const std::vector<Node> & getNodes() const { return nodes; }
+    const std::vector<PackedTriangles> & getTriangles() const { return triangles; }
+    unsigned getNbLeaves() const { return stats.nbLeaves; }
+    const Stats & getStats() const { return stats; }
+
+    /** Call f on the box of every node, depth first */
+    void exec(void (*f)(const BoundingBox &)) const;
+
+    /**
+     * Keeps in hit the closest of its hit and the ones of the tree
+     * Nodes behind hit are skipped, so hit may come from other objects
+     * as long as ray is translated in the space of each of them.
+     */
+    bool intersect(const BasicRay &ray, Hit &hit) const;
+    inline bool intersect(Ray &ray) const { return intersect(ray.getBasicRay(), ray.getHit()); }
+
+    /** True if a triangle is hit at ray origin + t * direction with 0 <= t < tMax */
+    bool occluded(const BasicRay &ray, float tMax) const;
+
+    /**
+     * Closest hits of a coherent packet (see RayPacket::isCoherent)
+     * Rays share the nodes they both cross, each ray keeps its own hit
+     */
+    bool intersect(RayPacket &packet) const;
+
+    /** Size of the traversal stacks, above any KDtreeBuilder depth bound */
+    static const unsigned MAX_DEPTH = 64;
 
 private:
-    KDtree(Object &o, const std::vector<unsigned> &triangles,
-           const BoundingBox &boundingBox):
-        o(o), triangles(triangles),
-        left(nullptr), right(nullptr),
-        splitAxis(Axis::NONE),
-        bBox(boundingBox) {
-        next();
-    }
+    Object &o;
+    std::vector<Node> nodes;
+    std::vector<PackedTriangles> triangles;
+    Stats stats;
 
+    KDtree(const KDtree &) = delete;
     KDtree & operator=(const KDtree &t) = delete;
 
-    void next();
-
-    inline void findSplitAxis();
-    inline void splitTriangles(const BoundingBox & lb, const BoundingBox & rb,
-                               std::vector<unsigned> &left, std::vector<unsigned> &right) const;
+    unsigned flatten(const KDtreeBuilderNode *b, unsigned depth);
+    /** Single ray traversal from node, ray being clipped to [tMin, tMax] */
+    bool traverse(const BasicRay &ray, Hit &hit, unsigned node, float tMin, float tMax) const;
+#ifdef __SSE2__
+    /** SSE traversal of a coherent packet */
+    void traverse(RayPacket &packet) const;
+#endif
+    void exec(void (*f)(const BoundingBox &), unsigned node, const BoundingBox & box) const;
 };
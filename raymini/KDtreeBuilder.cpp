@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#include "KDtreeBuilder.h"
+#include "Mesh.h"
+
+using namespace std;
+
+KDtreeBuilder::KDtreeBuilder(const Mesh &mesh, const BoundingBox &boundingBox, KDtree::Split split):
+    bBox(boundingBox),
+    mesh(mesh),
+    split(split),
+    nodeArenas(max(omp_get_max_threads(), 1)),
+    scratchArenas(max(omp_get_max_threads(), 1)),
+    root(nullptr) {
+    const unsigned n = mesh.getTriangles().size();
+    unsigned *triangles = nodeArenas[0].allocate<unsigned>(n);
+    for(unsigned int i = 0 ; i < n ; i++)
+        triangles[i] = i;
+    // Usual bound to avoid degenerated trees (pbrt)
+    maxDepth = 8 + unsigned(1.3f*log2(float(n+1)));
+
+    #pragma omp parallel if(n >= TASK_MIN_TRIANGLES)
+    #pragma omp single
+    root = build(triangles, n, bBox, 0);
+}
+
+const KDtreeBuilder::Node * KDtreeBuilder::build(const unsigned *triangles, unsigned n,
+                                                 const BoundingBox &box, unsigned depth) {
+    const unsigned thread = omp_get_thread_num();
+    Arena &scratch = scratchArenas[thread];
+    const Arena::Mark mark = scratch.getMark();
+    Node *node = nodeArenas[thread].allocate<Node>(1);
+
+    unsigned *lt = scratch.allocate<unsigned>(n);
+    unsigned *rt = scratch.allocate<unsigned>(n);
+    unsigned nl = 0, nr = 0;
+    Axis axis = Axis::NONE;
+    float cut = 0.f;
+    bool splitted = (split == KDtree::SAH) ?
+        findSAHSplit(triangles, n, box, depth, scratch, axis, cut, lt, nl, rt, nr) :
+        findMedianSplit(triangles, n, box, depth, scratch, axis, cut, lt, nl, rt, nr);
+
+    if(!splitted) {
+        unsigned *leafTriangles = nodeArenas[thread].allocate<unsigned>(n);
+        copy(triangles, triangles+n, leafTriangles);
+        *node = {Axis::NONE, 0.f, nullptr, nullptr, leafTriangles, n};
+        scratch.release(mark);
+        return node;//leaf
+    }
+
+    *node = {axis, cut, nullptr, nullptr, nullptr, 0};
+    BoundingBox lb, rb;
+    box.split(cut, axis, lb, rb);
+
+    // Tied tasks resume on their thread: scratch is released in stack order
+    if(n >= TASK_MIN_TRIANGLES) {
+        #pragma omp task
+        node->left = build(lt, nl, lb, depth+1);
+        node->right = build(rt, nr, rb, depth+1);
+        #pragma omp taskwait
+    }
+    else {
+        node->left = build(lt, nl, lb, depth+1);
+        node->right = build(rt, nr, rb, depth+1);
+    }
+
+    scratch.release(mark);
+    return node;
+}
+
+template<class Side>
+void KDtreeBuilder::partition(const unsigned *triangles, unsigned n, const Side &side, Arena &scratch,
+                              unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const {
+    const unsigned nbChunks = (n + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES;
+    if(nbChunks <= 1) {
+        nl = nr = 0;
+        for(unsigned i = 0 ; i < n ; i++) {
+            const unsigned s = side(i);
+            if(s & 1)
+                lt[nl++] = triangles[i];
+            if(s & 2)
+                rt[nr++] = triangles[i];
+        }
+        return;
+    }
+
+    // Count each chunk, then write each chunk from its offset
+    unsigned *leftOffsets = scratch.allocate<unsigned>(nbChunks+1);
+    unsigned *rightOffsets = scratch.allocate<unsigned>(nbChunks+1);
+    for(unsigned c = 0 ; c < nbChunks ; c++) {
+        #pragma omp task
+        {
+            unsigned l = 0, r = 0;
+            for(unsigned i = c*CHUNK_TRIANGLES ; i < min(n, (c+1)*CHUNK_TRIANGLES) ; i++) {
+                const unsigned s = side(i);
+                l += s & 1;
+                r += s >> 1;
+            }
+            leftOffsets[c+1] = l;
+            rightOffsets[c+1] = r;
+        }
+    }
+    #pragma omp taskwait
+
+    leftOffsets[0] = rightOffsets[0] = 0;
+    for(unsigned c = 0 ; c < nbChunks ; c++) {
+        leftOffsets[c+1] += leftOffsets[c];
+        rightOffsets[c+1] += rightOffsets[c];
+    }
+
+    for(unsigned c = 0 ; c < nbChunks ; c++) {
+        #pragma omp task
+        {
+            unsigned l = leftOffsets[c], r = rightOffsets[c];
+            for(unsigned i = c*CHUNK_TRIANGLES ; i < min(n, (c+1)*CHUNK_TRIANGLES) ; i++) {
+                const unsigned s = side(i);
+                if(s & 1)
+                    lt[l++] = triangles[i];
+                if(s & 2)
+                    rt[r++] = triangles[i];
+            }
+        }
+    }
+    #pragma omp taskwait
+
+    nl = leftOffsets[nbChunks];
+    nr = rightOffsets[nbChunks];
+}
+
+bool KDtreeBuilder::findMedianSplit(const unsigned *triangles, unsigned n, const BoundingBox &box, unsigned depth,
+                                    Arena &scratch, Axis &axis, float &cut,
+                                    unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const {
+    if(n <= MIN_TRIANGLES || depth >= maxDepth) return false;
+
+    axis = longestAxis(box);
+    cut = box.getMiddle(axis);
+
+    BoundingBox lb, rb;
+    box.split(cut, axis, lb, rb);
+    auto side = [&](unsigned i) {
+        unsigned s = 0;
+        const Triangle & triangle = mesh.getTriangles()[triangles[i]];
+        for(unsigned v = 0 ; v < 3 ; v++) {
+            const Vec3Df & p = mesh.getVertices()[triangle.getVertex(v)].getPos();
+            if(lb.contains(p))
+                s |= 1;
+            else if(rb.contains(p))
+                s |= 2;
+        }
+        return s;
+    };
+    partition(triangles, n, side, scratch, lt, nl, rt, nr);
+    return true;
+}
+
+BoundingBox KDtreeBuilder::clippedTriangleBox(unsigned t, const BoundingBox &box) const {
+    const Triangle & triangle = mesh.getTriangles()[t];
+    BoundingBox triangleBox(mesh.getVertices()[triangle.getVertex(0)].getPos());
+    triangleBox.extendTo(mesh.getVertices()[triangle.getVertex(1)].getPos());
+    triangleBox.extendTo(mesh.getVertices()[triangle.getVertex(2)].getPos());
+
+    Vec3Df min = triangleBox.getMin(), max = triangleBox.getMax();
+    for(unsigned i = 0 ; i < 3 ; i++) {
+        min[i] = std::max(min[i], box.getMin()[i]);
+        max[i] = std::min(max[i], box.getMax()[i]);
+    }
+    return BoundingBox(min, max);
+}
+
+bool KDtreeBuilder::findSAHSplit(const unsigned *triangles, unsigned n, const BoundingBox &box, unsigned depth,
+                                 Arena &scratch, Axis &axis, float &cut,
+                                 unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const {
+    if(n <= SAH_MIN_TRIANGLES || depth >= maxDepth) return false;
+
+    const Vec3Df & min = box.getMin();
+    const Vec3Df extent = box.getMax() - min;
+    const float invArea = 1.f/(extent[0]*extent[1] + extent[1]*extent[2] + extent[2]*extent[0]);
+
+    // Triangles starting / ending in each bin, for each axis and each chunk
+    static const unsigned CHUNK_BINS = 3*2*SAH_BINS;
+    const unsigned nbChunks = max((n + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES, 1u);
+    BoundingBox *boxes = scratch.allocate<BoundingBox>(n);
+    unsigned *bins = scratch.allocate<unsigned>(nbChunks*CHUNK_BINS);
+    auto binChunk = [&](unsigned c) {
+        unsigned *chunkBins = bins + c*CHUNK_BINS;
+        fill(chunkBins, chunkBins+CHUNK_BINS, 0);
+        for(unsigned i = c*CHUNK_TRIANGLES ; i < std::min(n, (c+1)*CHUNK_TRIANGLES) ; i++) {
+            boxes[i] = clippedTriangleBox(triangles[i], box);
+            for(unsigned a = 0 ; a < 3 ; a++) {
+                if(extent[a] <= 0.f) continue;
+                const float binsPerUnit = SAH_BINS/extent[a];
+                auto bin = [&](float x) {
+                    int b = int((x - min[a])*binsPerUnit);
+                    return unsigned(std::min(std::max(b, 0), int(SAH_BINS)-1));
+                };
+                chunkBins[2*a*SAH_BINS + bin(boxes[i].getMin()[a])]++;
+                chunkBins[(2*a+1)*SAH_BINS + bin(boxes[i].getMax()[a])]++;
+            }
+        }
+    };
+    if(nbChunks == 1) {
+        binChunk(0);
+    }
+    else {
+        for(unsigned c = 0 ; c < nbChunks ; c++) {
+            #pragma omp task
+            binChunk(c);
+        }
+        #pragma omp taskwait
+        for(unsigned c = 1 ; c < nbChunks ; c++)
+            for(unsigned k = 0 ; k < CHUNK_BINS ; k++)
+                bins[k] += bins[c*CHUNK_BINS + k];
+    }
+
+    // Leaves are tested PackedTriangles::WIDTH triangles at once
+    auto packets = [](unsigned count) {
+        return float((count + PackedTriangles::WIDTH - 1) / PackedTriangles::WIDTH);
+    };
+
+    float bestCost = SAH_INTERSECTION_COST * packets(n);// cost of a leaf
+    bool found = false;
+
+    for(unsigned a = 0 ; a < 3 ; a++) {
+        if(extent[a] <= 0.f) continue;
+        const unsigned *starts = bins + 2*a*SAH_BINS;
+        const unsigned *ends = bins + (2*a+1)*SAH_BINS;
+
+        const unsigned o1 = (a+1)%3, o2 = (a+2)%3;
+        const float capArea = extent[o1]*extent[o2];
+        const float sideLength = extent[o1]+extent[o2];
+
+        // Sweep the planes between bins
+        unsigned nLeft = 0, nRight = n;
+        for(unsigned k = 1 ; k < SAH_BINS ; k++) {
+            nLeft += starts[k-1];
+            nRight -= ends[k-1];
+
+            float leftLength = extent[a]*float(k)/SAH_BINS;
+            float rightLength = extent[a] - leftLength;
+            float leftArea = capArea + leftLength*sideLength;
+            float rightArea = capArea + rightLength*sideLength;
+
+            float bonus = (nLeft == 0 || nRight == 0) ? SAH_EMPTY_BONUS : 0.f;
+            float cost = SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST * (1.f-bonus) *
+                (leftArea*packets(nLeft) + rightArea*packets(nRight)) * invArea;
+
+            if(cost < bestCost) {
+                bestCost = cost;
+                axis = Axis(a);
+                cut = min[a] + leftLength;
+                found = true;
+            }
+        }
+    }
+
+    if(!found) return false;
+
+    // Conservative classification: a triangle goes in every child its box overlaps
+    const Axis splitAxis = axis;
+    const float splitCut = cut;
+    auto side = [&](unsigned i) {
+        return unsigned(boxes[i].getMin()[splitAxis] <= splitCut) |
+            (unsigned(boxes[i].getMax()[splitAxis] >= splitCut) << 1);
+    };
+    partition(triangles, n, side, scratch, lt, nl, rt, nr);
+
+    // Everything straddles the plane: splitting is useless
+    if(nl == n && nr == n) return false;
+    return true;
+}
+
+Axis KDtreeBuilder::longestAxis(const BoundingBox &box) {
+    Vec3Df delta = box.getMax()-box.getMin();
+
+    if(delta[0] <= delta[1]) {
+        if(delta[1] <= delta[2])
+            return Axis::Z;
+        else
+            return Axis::Y;
+    }
+    else {
+        if(delta[0] <= delta[2])
+            return Axis::Z;
+        else
+            return Axis::X;
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BoundingBox.h"
+#include "KDtree.h"
+
+class Mesh;
+
+/** Node of a KDtreeBuilder */
+class KDtreeBuilderNode {
+public:
+    /** NONE for leaves */
+    Axis splitAxis;
+    float cut;
+    const KDtreeBuilderNode *left, *right;
+    const unsigned *triangles;
+    unsigned nbTriangles;
+
+    inline bool isLeaf() const { return splitAxis == Axis::NONE; }
+};
+
+/**
+ * Kd-tree used at construction time only
+ * KDtree flattens it into its compact node array and drops it
+ *
+ * Subtrees are built in parallel as OpenMP tasks, and the binning and
+ * partitioning of big nodes are split in chunks of triangles.
+ * Nodes, leaf triangles and the temporary triangle lists of nodes being
+ * split live in per-thread arenas, so that no list is copied per node.
+ */
+class KDtreeBuilder {
+public:
+    static const unsigned MIN_TRIANGLES = 20;
+
+    // SAH cost model
+    static const unsigned SAH_BINS = 32;
+    static const unsigned SAH_MIN_TRIANGLES = 2;
+    static constexpr float SAH_TRAVERSAL_COST = 1.f;
+    static constexpr float SAH_INTERSECTION_COST = 1.f;
+    /** Cost reduction granted to splits isolating empty space */
+    static constexpr float SAH_EMPTY_BONUS = 0.2f;
+
+    /** Smallest subtree built in its own task */
+    static const unsigned TASK_MIN_TRIANGLES = 1024;
+    /** Triangles per chunk when binning and partitioning big nodes */
+    static const unsigned CHUNK_TRIANGLES = 8192;
+
+    typedef KDtreeBuilderNode Node;
+
+    const BoundingBox bBox;
+
+    KDtreeBuilder(const Mesh &mesh, const BoundingBox &boundingBox, KDtree::Split split);
+
+    const Node & getRoot() const { return *root; }
+
+private:
+    /**
+     * Memory handed out from big blocks, never moved
+     * Allocations are freed all at once with the arena, or back to a mark
+     */
+    class Arena {
+    public:
+        class Mark {
+        public:
+            unsigned block;
+            size_t offset;
+        };
+
+        Arena(): block(0), offset(0) {}
+
+        template<class T> T * allocate(size_t n) {
+            const size_t size = n*sizeof(T);
+            offset = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+            while (block < blocks.size() && offset + size > sizes[block]) {
+                block++;
+                offset = 0;
+            }
+            if (block == blocks.size()) {
+                sizes.push_back(size > BLOCK_SIZE ? size : size_t(BLOCK_SIZE));
+                blocks.emplace_back(new char[sizes.back()]);
+            }
+            T *p = reinterpret_cast<T *>(blocks[block].get() + offset);
+            offset += size;
+            return p;
+        }
+
+        inline Mark getMark() const { return {block, offset}; }
+        inline void release(const Mark &m) {
+            block = m.block;
+            offset = m.offset;
+        }
+
+    private:
+        static const size_t BLOCK_SIZE = 1 << 20;
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::vector<size_t> sizes;
+        unsigned block;
+        size_t offset;
+    };
+
+    const Mesh &mesh;
+    KDtree::Split split;
+    /** Nodes at this depth stay leaves, whatever the split, so that traversals never overflow */
+    unsigned maxDepth;
+    /** Nodes and leaf triangles, one per thread */
+    std::vector<Arena> nodeArenas;
+    /** Triangle lists and boxes of nodes being split, one per thread */
+    std::vector<Arena> scratchArenas;
+    const Node *root;
+
+    KDtreeBuilder(const KDtreeBuilder &) = delete;
+    KDtreeBuilder & operator=(const KDtreeBuilder &t) = delete;
+
+    const Node * build(const unsigned *triangles, unsigned n, const BoundingBox &box, unsigned depth);
+
+    /**
+     * Median split, return false if the node has to stay a leaf
+     * Fill lt and rt, and their sizes nl and nr
+     */
+    bool findMedianSplit(const unsigned *triangles, unsigned n, const BoundingBox &box, unsigned depth,
+                         Arena &scratch, Axis &axis, float &cut,
+                         unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const;
+    /** Same as above with the SAH */
+    bool findSAHSplit(const unsigned *triangles, unsigned n, const BoundingBox &box, unsigned depth,
+                      Arena &scratch, Axis &axis, float &cut,
+                      unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const;
+
+    /**
+     * Split triangles between lt and rt by chunks, preserving their order
+     * side(i) returns 1 if triangles[i] goes left, 2 if it goes right, 3 for both
+     */
+    template<class Side>
+    void partition(const unsigned *triangles, unsigned n, const Side &side, Arena &scratch,
+                   unsigned *lt, unsigned &nl, unsigned *rt, unsigned &nr) const;
+
+    /** Bounding box of a triangle clipped to box */
+    BoundingBox clippedTriangleBox(unsigned t, const BoundingBox &box) const;
+
+    static Axis longestAxis(const BoundingBox &box);
+};
@@ -16,7 +16,9 @@ public:
     inline Light (const Vec3Df & pos, const Vec3Df & color, float intensity)
         : pos (pos), radius (0.f), color (color), intensity (intensity), enabled(true) {}
     inline Light (const Vec3Df & pos, float radius, const Vec3Df & normal, const Vec3Df & color, float intensity)
-        : pos (pos), radius (radius), normal(normal), color (color), intensity (intensity), enabled(true) {}
+        : pos (pos), radius (radius), normal(normal), color (color), intensity (intensity), enabled(true) {
+        this->normal.normalize ();
+    }
     virtual ~Light () {}
 
     inline const Vec3Df & getPos () const { return pos; }
@@ -27,13 +29,32 @@ public:
 
     inline void setPos (const Vec3Df & p) { pos = p; }
     inline void setColor (const Vec3Df & c) { color = c; }
-    inline void setNormal (const Vec3Df & n) { normal = n; }
+    /** Normals are kept normalized, for getDensity */
+    inline void setNormal (const Vec3Df & n) { normal = n; normal.normalize (); }
     inline void setIntensity (float i) { intensity = i; }
     inline void setRadius (float r) { radius = r; }
 
     inline void setEnabled(bool e) { enabled = e; }
     inline bool isEnabled() const { return enabled; }
 
+    /** Distance along the normalized dir from origin to the disc of the light, false if it is missed */
+    inline bool intersect (const Vec3Df & origin, const Vec3Df & dir, float & distance) const {
+        float cosine = Vec3Df::dotProduct (dir, normal);
+        if (radius == 0.f || cosine == 0.f)
+            return false;
+        distance = Vec3Df::dotProduct (pos - origin, normal) / cosine;
+        return distance > 0.f && (origin + distance*dir - pos).getSquaredLength () <= radius*radius;
+    }
+
+    /**
+     * Density, per solid angle seen from distance along the normalized dir,
+     * of points uniform on the disc, infinite for points
+     */
+    inline float getDensity (const Vec3Df & dir, float distance) const {
+        float projectedArea = float(M_PI)*radius*radius*std::fabs (Vec3Df::dotProduct (dir, normal));
+        return projectedArea > 0.f ? distance*distance/projectedArea : INFINITY;
+    }
+
 private:
     Vec3Df pos;
     float radius;
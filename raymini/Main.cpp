@@ -5,7 +5,6 @@
 #include "QTUtils.h"
 
 int main (int argc, char **argv) {
-    srand(time(NULL));
     QApplication raymini(argc, argv);
     setBoubekQTStyle (raymini);
     QApplication::setStyle (new QPlastiqueStyle);
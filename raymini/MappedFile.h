@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/** Read only mapping of a whole file, not mapped if it cannot be read or is empty */
+class MappedFile {
+public:
+    MappedFile(const std::string &path);
+    ~MappedFile();
+
+    inline bool isMapped() const { return data != nullptr; }
+    inline const char * getData() const { return data; }
+    inline size_t getSize() const { return size; }
+
+private:
+    const char *data;
+    size_t size;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+};
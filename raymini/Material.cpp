@@ -10,13 +10,13 @@
 #include "Material.h"
 
 #include "RayTracer.h"
-#include "Controller.h"
+#include "BaseController.h"
 #include "Object.h"
 #include "Ray.h"
 
 using namespace std;
 
-Material::Material(Controller *c, std::string name,
+Material::Material(BaseController *c, std::string name,
                    const ColorTexture *ct, const NormalTexture *nt):
     NamedClass(name),
     controller(c),
@@ -27,7 +27,7 @@ Material::Material(Controller *c, std::string name,
     normalTexture(nt)
 {}
 
-Material::Material(Controller *c,
+Material::Material(BaseController *c,
                    std::string name,
                    float diffuse,
                    float specular,
@@ -50,7 +50,7 @@ Vec3Df Material::genColor (const Vec3Df & camPos,
                            const std::vector<Light> & lights, Brdf::Type type) const {
     const Vertex &closestIntersection = intersectingRay->getIntersection();
     float ambientOcclusionContribution = (type & Brdf::Ambient)?
-        controller->getRayTracer()->getAmbientOcclusion(closestIntersection):
+        controller->getRayTracer()->getAmbientOcclusion(closestIntersection, intersectingRay->getTime()):
         0.f;
 
     Vec3Df usedColor = colorTexture->getColor(intersectingRay);
@@ -79,7 +79,8 @@ Vec3Df Material::genColor (const Vec3Df & camPos,
     Vec3Df dir = (camPos-pos).reflect(normal);
     dir.normalize();
 
-    const Vec3Df reflectedColor = controller->getRayTracer()->getColor(dir, pos, false);
+    const Vec3Df reflectedColor = controller->getRayTracer()->getColor(dir, pos, false,
+                                                                       intersectingRay->getTime());
 
     return spec + Vec3Df::interpolate(glossyColor, reflectedColor, glossyRatio);
 }
@@ -88,6 +89,7 @@ Vec3Df Glass::genColor (const Vec3Df & camPos,
                         Ray *r,
                         const std::vector<Light> &lights, Brdf::Type type) const {
     const Object *o = r->getIntersectedObject();
+    const Vec3Df trans = o->getTrans(r->getTime());
     float size = o->getBoundingBox().getRadius();
     const Vertex &closestIntersection = r->getIntersection();
     const Vec3Df & pos = closestIntersection.getPos();
@@ -99,15 +101,15 @@ Vec3Df Glass::genColor (const Vec3Df & camPos,
     dir.normalize();
 
     //Works well only for convex object
-    Ray ray(pos-o->getTrans()+3*size*dir, -dir);
+    Ray ray(pos-trans+3*size*dir, -dir, r->getTime());
     if (!o->getKDtree().intersect(ray)) {
-        return controller->getRayTracer()->getColor(pos+size*dir, pos-camPos);
+        return controller->getRayTracer()->getColor(pos+size*dir, pos-camPos, true, r->getTime());
     }
 
     const Vertex i = ray.getIntersection();
     dir = (-dir).refract(coeff,-normalTexture->getNormal(&ray), 1);
 
-    Vec3Df glassColor = controller->getRayTracer()->getColor(dir, i.getPos()+o->getTrans(), false);
+    Vec3Df glassColor = controller->getRayTracer()->getColor(dir, i.getPos()+trans, false, r->getTime());
 
     Vec3Df brdfColor = Vec3Df();
     // If at least slightly opaque
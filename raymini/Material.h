@@ -20,18 +20,24 @@
 
 // This model assumes a white specular color (1.0, 1.0, 1.0)
 
-class Controller;
+class BaseController;
 class Object;
 
 class Material: public NamedClass {
 public:
-    Material(Controller *c, std::string name, const ColorTexture *ct, const NormalTexture *nt);
-    Material(Controller *c, std::string name, float diffuse, float specular,
+    Material(BaseController *c, std::string name, const ColorTexture *ct, const NormalTexture *nt);
+    Material(BaseController *c, std::string name, float diffuse, float specular,
              const ColorTexture *ct, const NormalTexture *nt,
              float glossyRatio=0, float alpha = 1.5f);
 
     virtual ~Material () {}
 
+    /** Light goes through objects made of transparent materials, they cast no shadow */
+    virtual bool isTransparent() const { return false; }
+
+    /** genColor is only the Brdf of the lights, without reflections or refractions */
+    virtual bool hasPlainBrdf() const { return !isGlossy(); }
+
     inline float getDiffuse () const { return diffuse; }
     inline float getSpecular () const { return specular; }
 
@@ -52,7 +58,7 @@ public:
     inline const NormalTexture *getNormalTexture() const {return normalTexture;}
 
 protected:
-    Controller *controller;
+    BaseController *controller;
 
     float diffuse;
     float specular;
@@ -64,13 +70,13 @@ protected:
 
 class Mirror : public Material {
 public:
-    Mirror(Controller *c, std::string name, const ColorTexture *ct, const NormalTexture *nt):
+    Mirror(BaseController *c, std::string name, const ColorTexture *ct, const NormalTexture *nt):
         Material(c, name, 0.5f, 1.f, ct, nt, 1.f, 30){}
 };
 
 class Glass : public Material {
 public:
-    Glass(Controller *c, std::string name, float coeff,
+    Glass(BaseController *c, std::string name, float coeff,
           const ColorTexture *ct, const NormalTexture *nt,
           float alpha=1):
         Material(c, name, 1.f, 1.f, ct, nt),
@@ -82,6 +88,9 @@ public:
 
     virtual ~Glass() {}
 
+    virtual bool isTransparent() const { return true; }
+    virtual bool hasPlainBrdf() const { return false; }
+
     virtual Vec3Df genColor (const Vec3Df & camPos,
                              Ray *intersectingRay,
                              const std::vector<Light> & lights, Brdf::Type type) const;
@@ -95,13 +104,15 @@ private:
 
 class SkyBoxMaterial: public Material {
 public:
-    SkyBoxMaterial(Controller *c, std::string name,
+    SkyBoxMaterial(BaseController *c, std::string name,
                    const ColorTexture *ct, const NormalTexture *nt):
         Material(c, name, 1, 0, ct, nt)
     {}
 
     virtual ~SkyBoxMaterial() {}
-    
+
+    virtual bool hasPlainBrdf() const { return false; }
+
     virtual Vec3Df genColor (const Vec3Df & camPos,
                              Ray *intersectingRay,
                              const std::vector<Light> & lights, Brdf::Type type) const;
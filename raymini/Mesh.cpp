@@ -6,19 +6,22 @@
 // ---------------------------------------------------------
 
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
 #include "Texture.h"
 #include "Material.h"
 #include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <GL/glew.h>
+#include <omp.h>
 
 using namespace std;
 
 void Mesh::clear () {
     clearTopology ();
     clearGeometry ();
+    cachePath.clear ();
 }
 
 void Mesh::clearGeometry () {
@@ -27,6 +30,7 @@ void Mesh::clearGeometry () {
 
 void Mesh::clearTopology () {
     triangles.clear ();
+    adjacencyValid = false;
 }
 
 void Mesh::unmarkAllVertices () {
@@ -34,191 +38,153 @@ void Mesh::unmarkAllVertices () {
         vertices[i].unmark ();
 }
 
+/** Smaller meshes are processed by a single thread */
+static const unsigned PARALLEL_MIN_SIZE = 1 << 12;
+
 void Mesh::computeTriangleNormals (vector<Vec3Df> & triangleNormals) {
-    for (vector<Triangle>::const_iterator it = triangles.begin ();
-         it != triangles.end ();
-         it++) {
-        Vec3Df e01 (vertices[it->getVertex (1)].getPos () - vertices[it->getVertex (0)].getPos ());
-        Vec3Df e02 (vertices[it->getVertex (2)].getPos () - vertices[it->getVertex (0)].getPos ());
+    triangleNormals.resize (triangles.size ());
+    #pragma omp parallel for if(triangles.size () >= PARALLEL_MIN_SIZE)
+    for (unsigned int t = 0; t < triangles.size (); t++) {
+        const Triangle & tt = triangles[t];
+        Vec3Df e01 (vertices[tt.getVertex (1)].getPos () - vertices[tt.getVertex (0)].getPos ());
+        Vec3Df e02 (vertices[tt.getVertex (2)].getPos () - vertices[tt.getVertex (0)].getPos ());
         Vec3Df n (Vec3Df::crossProduct (e01, e02));
         n.normalize ();
-        triangleNormals.push_back (n);
+        triangleNormals[t] = n;
     }
 }
 
 void Mesh::recomputeSmoothVertexNormals (unsigned int normWeight) {
-    vector<Vec3Df> triangleNormals;
-    computeTriangleNormals (triangleNormals);
-    for (std::vector<Vertex>::iterator it = vertices.begin (); it != vertices.end (); it++)
-        it->setNormal (Vec3Df (0.0, 0.0, 0.0));
-    vector<Vec3Df>::const_iterator itNormal = triangleNormals.begin ();
-    vector<Triangle>::const_iterator it = triangles.begin ();
-    for ( ; it != triangles.end (); it++, itNormal++)
-        for (unsigned int  j = 0; j < 3; j++) {
-            Vertex & vj = vertices[it->getVertex (j)];
+    const unsigned int nbTriangles = triangles.size ();
+    const unsigned int nbVertices = vertices.size ();
+    const bool parallel = nbTriangles >= PARALLEL_MIN_SIZE && omp_get_max_threads () > 1;
+
+    // Weighted normal brought by each corner of each triangle
+    vector<Vec3Df> cornerNormals (3*nbTriangles);
+    #pragma omp parallel for if(parallel)
+    for (unsigned int t = 0; t < nbTriangles; t++) {
+        const Triangle & tt = triangles[t];
+        Vec3Df e01 (vertices[tt.getVertex (1)].getPos () - vertices[tt.getVertex (0)].getPos ());
+        Vec3Df e02 (vertices[tt.getVertex (2)].getPos () - vertices[tt.getVertex (0)].getPos ());
+        Vec3Df n (Vec3Df::crossProduct (e01, e02));
+        n.normalize ();
+        for (unsigned int j = 0; j < 3; j++) {
+            const Vec3Df & pj = vertices[tt.getVertex (j)].getPos ();
             float w = 1.0; // uniform weights
-            Vec3Df e0 = vertices[it->getVertex ((j+1)%3)].getPos () - vj.getPos ();
-            Vec3Df e1 = vertices[it->getVertex ((j+2)%3)].getPos () - vj.getPos ();
-            if (normWeight == 1) { // area weight
+            Vec3Df e0 = vertices[tt.getVertex ((j+1)%3)].getPos () - pj;
+            Vec3Df e1 = vertices[tt.getVertex ((j+2)%3)].getPos () - pj;
+            if (normWeight == AREA_WEIGHT) {
                 w = Vec3Df::crossProduct (e0, e1).getLength () / 2.0;
-            } else if (normWeight == 2) { // angle weight
+            } else if (normWeight == ANGLE_WEIGHT) {
                 e0.normalize ();
                 e1.normalize ();
                 w = (2.0 - (Vec3Df::dotProduct (e0, e1) + 1.0)) / 2.0;
             }
-            if (w <= 0.0)
-                continue;
-            vj.setNormal (vj.getNormal () + (*itNormal) * w);
-        }
-    Vertex::normalizeNormals (vertices);
-}
-
-void Mesh::collectOneRing (vector<vector<unsigned int> > & oneRing) const {
-    oneRing.resize (vertices.size ());
-    for (unsigned int i = 0; i < triangles.size (); i++) {
-        const Triangle & ti = triangles[i];
-        for (unsigned int j = 0; j < 3; j++) {
-            unsigned int vj = ti.getVertex (j);
-            for (unsigned int k = 1; k < 3; k++) {
-                unsigned int vk = ti.getVertex ((j+k)%3);
-                if (find (oneRing[vj].begin (), oneRing[vj].end (), vk) == oneRing[vj].end ())
-                    oneRing[vj].push_back (vk);
-            }
+            cornerNormals[3*t+j] = w <= 0.0 ? Vec3Df (0.0, 0.0, 0.0) : n * w;
         }
     }
-}
 
-void Mesh::collectOrderedOneRing (vector<vector<unsigned int> > & oneRing) const {
-    oneRing.resize (vertices.size ());
-    for (unsigned int t = 0; t < triangles.size (); t++) {
-        const Triangle & ti = triangles[t];
-        for (unsigned int i = 0; i < 3; i++) {
-            unsigned int vi = ti.getVertex (i);
-            unsigned int vj = ti.getVertex ((i+1)%3);
-            unsigned int vk = ti.getVertex ((i+2)%3);
-            vector<unsigned int> & oneRingVi = oneRing[vi];
-            vector<unsigned int>::iterator begin = oneRingVi.begin ();
-            vector<unsigned int>::iterator end = oneRingVi.end ();
-            vector<unsigned int>::iterator nj = find (begin, end, vj);
-            vector<unsigned int>::iterator nk = find (begin, end, vk);
-            if (nj != end && nk == end) {
-                if (nj == begin)
-                    nj = end;
-                nj--;
-                oneRingVi.insert (nj, vk);
-            } else if (nj == end && nk != end)
-                oneRingVi.insert (nk, vj);
-            else if (nj == end && nk == end) {
-                oneRingVi.push_back (vk);
-                oneRingVi.push_back (vj);
-            }
+    if (!parallel) {
+        for (Vertex & v : vertices)
+            v.setNormal (Vec3Df (0.0, 0.0, 0.0));
+        for (unsigned int c = 0; c < 3*nbTriangles; c++) {
+            Vertex & v = vertices[triangles[c/3].getVertex (c%3)];
+            v.setNormal (v.getNormal () + cornerNormals[c]);
         }
+        Vertex::normalizeNormals (vertices);
+        return;
     }
-}
 
-void Mesh::computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2) {
-    for (vector<Triangle>::iterator it = triangles.begin ();
-         it != triangles.end (); it++) {
-        for (unsigned int i = 0; i < 3; i++) {
-            Edge eij (it->getVertex (i), it->getVertex ((i+1)%3));
-            if (dualVMap1.find (eij) == dualVMap1.end ())
-                dualVMap1[eij] = it->getVertex ((i+2)%3);
-            else
-                dualVMap2[eij] = it->getVertex ((i+2)%3);
-        }
+    // Corners around each vertex are in triangle order, so that every
+    // vertex gathers its normal alone and sums in the same order as the scatter
+    const MeshAdjacency & adjacency = getAdjacency ();
+    #pragma omp parallel for
+    for (unsigned int i = 0; i < nbVertices; i++) {
+        Vec3Df n (0.0, 0.0, 0.0);
+        for (unsigned int c : adjacency.getCorners (i))
+            n += cornerNormals[c];
+        if (n != Vec3Df (0.0, 0.0, 0.0))
+            n.normalize ();
+        vertices[i].setNormal (n);
     }
 }
 
-void Mesh::markBorderEdges (EdgeMapIndex & edgeMap) {
-    for (vector<Triangle>::iterator it = triangles.begin ();
-         it != triangles.end (); it++) {
-        for (unsigned int i = 0; i < 3; i++) {
-            unsigned int j = (i+1)%3;
-            Edge eij (it->getVertex (i), it->getVertex (j));
-            if (edgeMap.find (eij) == edgeMap.end ())
-                edgeMap[eij] = 0;
-            else
-                edgeMap[eij] += 1;
-        }
+const MeshAdjacency & Mesh::getAdjacency () const {
+    // Rare and short next to the queries, a single lock for all meshes is enough
+    #pragma omp critical (meshAdjacency)
+    if (!adjacencyValid || adjacency.getNbVertices () != vertices.size ()) {
+        adjacency = MeshAdjacency (vertices.size (), triangles);
+        adjacencyValid = true;
     }
+    return adjacency;
 }
 
-inline void glVertexVec3Df (const Vec3Df & v) {
-    glVertex3f (v[0], v[1], v[2]);
+void Mesh::collectOneRing (vector<vector<unsigned int> > & oneRing) const {
+    const MeshAdjacency & adjacency = getAdjacency ();
+    oneRing.resize (vertices.size ());
+    for (unsigned int i = 0; i < vertices.size (); i++) {
+        MeshAdjacency::Range neighbors = adjacency.getNeighbors (i);
+        oneRing[i].assign (neighbors.begin (), neighbors.end ());
+    }
 }
 
-inline void glNormalVec3Df (const Vec3Df & n) {
-    glNormal3f (n[0], n[1], n[2]);
+void Mesh::collectOrderedOneRing (vector<vector<unsigned int> > & oneRing) const {
+    const MeshAdjacency & adjacency = getAdjacency ();
+    oneRing.resize (vertices.size ());
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        adjacency.collectOrderedOneRing (i, oneRing[i]);
 }
 
-inline void glDrawPoint (const Vec3Df & pos, const Vec3Df & normal) {
-    glNormalVec3Df (normal);
-    glVertexVec3Df (pos);
-}
+// Edges are inserted in the order of compareEdge (lower vertex increasing,
+// higher vertex decreasing), so that each insertion at the end is constant time
 
-inline void glDrawPoint (const Vertex & v) {
-    glDrawPoint (v.getPos (), v.getNormal ());
+void Mesh::computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2) {
+    const MeshAdjacency & adjacency = getAdjacency ();
+    for (unsigned int v = 0; v < vertices.size (); v++)
+        for (unsigned int e = adjacency.getFirstEdge (v+1); e-- > adjacency.getFirstEdge (v); ) {
+            MeshAdjacency::Range halfEdges = adjacency.getHalfEdges (e);
+            Edge eij = adjacency.getEdgeVertices (e);
+            unsigned int first = adjacency.getVertex (adjacency.getPrevious (halfEdges[0]));
+            dualVMap1.insert (dualVMap1.end (), make_pair (eij, 0u))->second = first;
+            if (halfEdges.size () > 1) {
+                unsigned int last = adjacency.getVertex (adjacency.getPrevious (halfEdges[halfEdges.size ()-1]));
+                dualVMap2.insert (dualVMap2.end (), make_pair (eij, 0u))->second = last;
+            }
+        }
 }
 
-void Mesh::renderGL (bool flat) const {
-    glBegin (GL_TRIANGLES);
-    for (unsigned int i = 0; i < triangles.size (); i++) {
-        const Triangle & t = triangles[i];
-        Vertex v[3];
-        for (unsigned int j = 0; j < 3; j++)
-            v[j] = vertices[t.getVertex(j)];
-        if (flat) {
-            Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
-                                                  v[2].getPos () - v[0].getPos ());
-            normal.normalize ();
-            glNormalVec3Df (normal);
+void Mesh::markBorderEdges (EdgeMapIndex & edgeMap) {
+    const MeshAdjacency & adjacency = getAdjacency ();
+    for (unsigned int v = 0; v < vertices.size (); v++)
+        for (unsigned int e = adjacency.getFirstEdge (v+1); e-- > adjacency.getFirstEdge (v); ) {
+            // Triangles of the edge after the first one, added to any previous count
+            EdgeMapIndex::iterator it = edgeMap.insert (edgeMap.end (), make_pair (adjacency.getEdgeVertices (e), ~0u));
+            it->second += adjacency.getHalfEdges (e).size ();
         }
-        for (unsigned int j = 0; j < 3; j++)
-            if (!flat)
-                glDrawPoint (v[j]);
-            else
-                glVertexVec3Df (v[j].getPos ());
-    }
-    glEnd ();
 }
 
-void Mesh::loadOFF (const std::string & filename) {
+void Mesh::load (const std::string & filename) {
     clear ();
-    ifstream input (filename.c_str ());
-    if (!input)
-        throw Exception ("Failing opening the file.");
-    string magic_word;
-    input >> magic_word;
-    if (magic_word != "OFF")
-        throw Exception ("Not an OFF file.");
-    unsigned int numOfVertices, numOfTriangles, numOfWhat;
-    input >> numOfVertices >> numOfTriangles >> numOfWhat;
-    for (unsigned int i = 0; i < numOfVertices; i++) {
-        Vec3Df pos;
-        Vec3Df col;
-        input >> pos;
-        vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
-    }
-    for (unsigned int i = 0; i < numOfTriangles; i++) {
-        unsigned int polygonSize;
-        input >> polygonSize;
-        vector<unsigned int> index (polygonSize);
-        for (unsigned int j = 0; j < polygonSize; j++)
-            input >> index[j];
-        for (unsigned int j = 1; j < (polygonSize - 1); j++)
-            triangles.push_back (Triangle (index[0], index[j], index[j+1]));
+    if (MeshCache::loadMesh(filename, *this)) {
+        cachePath = MeshCache::getCachePath(filename);
+        return;
     }
-    input.close ();
+    MeshLoader::load (filename, vertices, triangles);
     recomputeSmoothVertexNormals (0);
     setDefaultTextureMapping();
+    if (MeshCache::saveMesh(filename, *this)) {
+        cachePath = MeshCache::getCachePath(filename);
+    }
 }
 
 void Mesh::rotate(const Vec3Df &axis, const float &angle) {
     Vec3Df normalizedAxis = axis;
     normalizedAxis.normalize();
 
-    for (Vertex & v : vertices) {
-        v.setPos(v.getPos().rotate(normalizedAxis, angle));
+    #pragma omp parallel for if(vertices.size() >= PARALLEL_MIN_SIZE)
+    for (unsigned i = 0; i < vertices.size(); i++) {
+        vertices[i].setPos(vertices[i].getPos().rotate(normalizedAxis, angle));
     }
 
     recomputeSmoothVertexNormals (0);
@@ -255,6 +221,7 @@ void Mesh::setDefaultTextureMapping(bool useNormals) {
 }
 
 void Mesh::returnTriangle(unsigned int t) {
+    adjacencyValid = false;
     Triangle &triangle = triangles[t];
     unsigned int temp = triangle.getVertex(0);
     float tempU = triangle.getU(0);
@@ -306,6 +273,8 @@ void Mesh::setSquareTextureMapping(unsigned indexTriangle0,
 }
 
 void Mesh::loadCube() {
+    cachePath.clear();
+    adjacencyValid = false;
     vertices.resize(8);
     triangles.resize(12);
 
@@ -380,6 +349,8 @@ void Mesh::setCubeTextureMapping(const Material *mat, unsigned widthGappedPixels
 }
 
 void Mesh::loadSquare() {
+    cachePath.clear();
+    adjacencyValid = false;
     triangles.resize(2);
     vertices.resize(4);
 
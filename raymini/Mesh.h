@@ -14,50 +14,77 @@
 #include "Vertex.h"
 #include "Triangle.h"
 #include "Edge.h"
+#include "MeshAdjacency.h"
 
 class Material;
 
 class Mesh {
 public:
-    inline Mesh (): uScale(1), vScale(1) {}
+    inline Mesh (): uScale(1), vScale(1), adjacencyValid(false) {}
     inline Mesh (const std::vector<Vertex> & v):
         vertices(v),
         uScale(1),
-        vScale(1)
+        vScale(1),
+        adjacencyValid(false)
     {}
     inline Mesh (const std::vector<Vertex> & v,
                  const std::vector<Triangle> & t):
         vertices(v),
         triangles(t),
         uScale(1),
-        vScale(1)
+        vScale(1),
+        adjacencyValid(false)
     {}
     inline Mesh (const Mesh & mesh):
         vertices(mesh.vertices),
         triangles (mesh.triangles),
         uScale(mesh.uScale),
-        vScale(mesh.vScale)
+        vScale(mesh.vScale),
+        cachePath(mesh.cachePath),
+        adjacencyValid(false)
     {}
 
     inline virtual ~Mesh () {}
     std::vector<Vertex> & getVertices () { return vertices; }
     const std::vector<Vertex> & getVertices () const { return vertices; }
+    /** Call invalidateAdjacency after changing the triangles */
     std::vector<Triangle> & getTriangles () { return triangles; }
     const std::vector<Triangle> & getTriangles () const { return triangles; }
     void clear ();
     void clearGeometry ();
     void clearTopology ();
     void unmarkAllVertices ();
+    /** Weightings of triangle normals for recomputeSmoothVertexNormals */
+    enum NormalWeight { UNIFORM_WEIGHT = 0, AREA_WEIGHT = 1, ANGLE_WEIGHT = 2 };
+
+    /** Average normals of the triangles around each vertex, in parallel */
     void recomputeSmoothVertexNormals (unsigned int weight);
+    /** Resize triangleNormals to the triangles and fill it, in parallel */
     void computeTriangleNormals (std::vector<Vec3Df> & triangleNormals);
+    /**
+     * Adjacency of the triangles, built on first use after the topology changed
+     * Threads may call it at the same time, the first one builds it.
+     */
+    const MeshAdjacency & getAdjacency () const;
+    /** The triangles were edited, the adjacency is built again when next needed */
+    inline void invalidateAdjacency () { adjacencyValid = false; }
+    /** Sorted neighbors of each vertex */
     void collectOneRing (std::vector<std::vector<unsigned int> > & oneRing) const;
+    /** Neighbors of each vertex turning around it, see MeshAdjacency::collectOrderedOneRing */
     void collectOrderedOneRing (std::vector<std::vector<unsigned int> > & oneRing) const;
     void computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2);
     void markBorderEdges (EdgeMapIndex & edgeMap);
 
+    /** OpenGL drawing, only available in the GUI, see GLDrawing.cpp */
     void renderGL (bool flat) const;
 
-    void loadOFF (const std::string & filename);
+    /**
+     * Load an OFF, PLY or OBJ file with MeshLoader
+     * Read the MeshCache of filename instead if it is up to date, write it otherwise
+     */
+    void load (const std::string & filename);
+    /** MeshCache of the file the mesh was loaded from, empty if none */
+    inline const std::string & getCachePath () const { return cachePath; }
 
     /** Rotate all vertices */
     void rotate(const Vec3Df &axis, const float &angle);
@@ -174,6 +201,10 @@ private:
     std::vector<Triangle> triangles;
 
     float uScale, vScale;
+    std::string cachePath;
+
+    mutable MeshAdjacency adjacency;
+    mutable bool adjacencyValid;
 };
 
 #endif // MESH_H
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <numeric>
+
+#include "MeshAdjacency.h"
+
+using namespace std;
+
+const unsigned MeshAdjacency::NONE;
+
+void MeshAdjacency::countingSort(const vector<unsigned> &keys, unsigned nbKeys,
+                                 vector<unsigned> &offsets, vector<unsigned> &list) {
+    offsets.assign(nbKeys+1, 0);
+    for (unsigned key : keys) {
+        if (key != NONE) {
+            offsets[key+1]++;
+        }
+    }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    list.resize(offsets.back());
+    vector<unsigned> next(offsets.begin(), offsets.end() - 1);
+    for (unsigned i = 0; i < keys.size(); i++) {
+        if (keys[i] != NONE) {
+            list[next[keys[i]]++] = i;
+        }
+    }
+}
+
+MeshAdjacency::MeshAdjacency(unsigned nbVertices, const vector<Triangle> &triangles):
+    cornerVertices(3*triangles.size()) {
+    const unsigned nbCorners = cornerVertices.size();
+    for (unsigned c = 0; c < nbCorners; c++) {
+        cornerVertices[c] = triangles[c/3].getVertex(c%3);
+    }
+    countingSort(cornerVertices, nbVertices, firstCorners, corners);
+
+    // Both other corners of each triangle around a vertex, sorted and
+    // deduplicated in place, then packed
+    vector<unsigned> candidates(2*nbCorners);
+    vector<unsigned> nbNeighbors(nbVertices+1, 0);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (unsigned v = 0; v < nbVertices; v++) {
+        unsigned *first = candidates.data() + 2*firstCorners[v];
+        unsigned *last = first;
+        for (unsigned c : getCorners(v)) {
+            *last++ = cornerVertices[getNext(c)];
+            *last++ = cornerVertices[getPrevious(c)];
+        }
+        sort(first, last);
+        last = unique(first, last);
+        last = remove(first, last, v);
+        nbNeighbors[v+1] = last - first;
+    }
+    firstNeighbors.resize(nbVertices+1);
+    partial_sum(nbNeighbors.begin(), nbNeighbors.end(), firstNeighbors.begin());
+    neighbors.resize(firstNeighbors.back());
+
+    // Each edge belongs to its lower vertex, edges of a vertex follow the
+    // order of its neighbors
+    vector<unsigned> nbEdges(nbVertices+1, 0);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (unsigned v = 0; v < nbVertices; v++) {
+        const unsigned *first = candidates.data() + 2*firstCorners[v];
+        copy(first, first + nbNeighbors[v+1], neighbors.begin() + firstNeighbors[v]);
+        const Range ring = getNeighbors(v);
+        nbEdges[v+1] = ring.end() - upper_bound(ring.begin(), ring.end(), v);
+    }
+    vector<unsigned>().swap(candidates);
+    firstEdges.resize(nbVertices+1);
+    partial_sum(nbEdges.begin(), nbEdges.end(), firstEdges.begin());
+
+    edgeVertices.resize(2*firstEdges.back());
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (unsigned v = 0; v < nbVertices; v++) {
+        const Range ring = getNeighbors(v);
+        unsigned e = firstEdges[v];
+        for (const unsigned *n = upper_bound(ring.begin(), ring.end(), v); n != ring.end(); n++, e++) {
+            edgeVertices[2*e] = v;
+            edgeVertices[2*e+1] = *n;
+        }
+    }
+
+    // Each half-edge is numbered from its lower end, whose neighbors are at hand
+    halfEdgeEdges.assign(nbCorners, NONE);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (unsigned v = 0; v < nbVertices; v++) {
+        const Range ring = getNeighbors(v);
+        const unsigned *above = upper_bound(ring.begin(), ring.end(), v);
+        for (unsigned c : getCorners(v)) {
+            const unsigned next = cornerVertices[getNext(c)];
+            const unsigned previous = cornerVertices[getPrevious(c)];
+            if (next > v) {
+                halfEdgeEdges[c] = firstEdges[v] + (lower_bound(above, ring.end(), next) - above);
+            }
+            if (previous > v) {
+                halfEdgeEdges[getPrevious(c)] = firstEdges[v] + (lower_bound(above, ring.end(), previous) - above);
+            }
+        }
+    }
+    countingSort(halfEdgeEdges, getNbEdges(), firstHalfEdges, halfEdges);
+
+    twins.assign(nbCorners, NONE);
+    #pragma omp parallel for
+    for (unsigned e = 0; e < getNbEdges(); e++) {
+        const Range along = getHalfEdges(e);
+        if (along.size() == 2 && cornerVertices[along[0]] != cornerVertices[along[1]]) {
+            twins[along[0]] = along[1];
+            twins[along[1]] = along[0];
+        }
+    }
+}
+
+void MeshAdjacency::collectOrderedOneRing(unsigned vertex, vector<unsigned> &ring) const {
+    const Range around = getCorners(vertex);
+    vector<bool> visited(around.size(), false);
+    auto visit = [&](unsigned corner) {
+        const unsigned i = lower_bound(around.begin(), around.end(), corner) - around.begin();
+        const bool first = !visited[i];
+        visited[i] = true;
+        return first;
+    };
+    // The corner after c is the one of the triangle across the edge to its previous corner
+    auto walk = [&](unsigned c) {
+        while (c != NONE && visit(c)) {
+            ring.push_back(cornerVertices[getPrevious(c)]);
+            c = twins[getPrevious(c)];
+        }
+    };
+
+    ring.clear();
+    for (unsigned i = 0; i < around.size(); i++) {
+        if (twins[around[i]] == NONE && !visited[i]) {
+            ring.push_back(cornerVertices[getNext(around[i])]);
+            walk(around[i]);
+        }
+    }
+    for (unsigned i = 0; i < around.size(); i++) {
+        if (!visited[i]) {
+            walk(around[i]);
+        }
+    }
+}
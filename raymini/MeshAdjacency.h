@@ -0,0 +1,95 @@
+#pragma once
+
+#include <climits>
+#include <vector>
+
+#include "Triangle.h"
+#include "Edge.h"
+
+/**
+ * Compressed adjacency of a triangle mesh
+ *
+ * Corner c is vertex c%3 of triangle c/3, half-edge c goes from corner c
+ * to the next corner of the same triangle. Every relation is stored as a
+ * compressed sparse row array (offsets and a flat list), built in linear
+ * time with counting sorts, and only small per-vertex lists are sorted.
+ */
+class MeshAdjacency {
+public:
+    static const unsigned NONE = UINT_MAX;
+
+    /** Part of one of the flat lists */
+    class Range {
+    public:
+        Range(const unsigned *first, const unsigned *last): first(first), last(last) {}
+        inline const unsigned * begin() const { return first; }
+        inline const unsigned * end() const { return last; }
+        inline unsigned size() const { return last - first; }
+        inline unsigned operator[](unsigned i) const { return first[i]; }
+    private:
+        const unsigned *first;
+        const unsigned *last;
+    };
+
+    MeshAdjacency() {}
+    MeshAdjacency(unsigned nbVertices, const std::vector<Triangle> &triangles);
+
+    inline unsigned getNbVertices() const { return firstCorners.empty() ? 0 : firstCorners.size() - 1; }
+    inline unsigned getNbEdges() const { return edgeVertices.size()/2; }
+
+    inline unsigned getVertex(unsigned corner) const { return cornerVertices[corner]; }
+    inline unsigned getNext(unsigned corner) const { return corner - corner%3 + (corner+1)%3; }
+    inline unsigned getPrevious(unsigned corner) const { return corner - corner%3 + (corner+2)%3; }
+
+    /** Corners of vertex, in triangle order */
+    inline Range getCorners(unsigned vertex) const {
+        return range(firstCorners, corners, vertex);
+    }
+    /** Vertices sharing an edge with vertex, sorted */
+    inline Range getNeighbors(unsigned vertex) const {
+        return range(firstNeighbors, neighbors, vertex);
+    }
+
+    /** Opposite half-edge, NONE on borders, non-manifold and badly oriented edges */
+    inline unsigned getTwin(unsigned halfEdge) const { return twins[halfEdge]; }
+    /** Edge of halfEdge, NONE if both its ends are the same vertex */
+    inline unsigned getEdge(unsigned halfEdge) const { return halfEdgeEdges[halfEdge]; }
+    inline Edge getEdgeVertices(unsigned edge) const {
+        return Edge(edgeVertices[2*edge], edgeVertices[2*edge+1]);
+    }
+    /** Half-edges along edge, in triangle order */
+    inline Range getHalfEdges(unsigned edge) const {
+        return range(firstHalfEdges, halfEdges, edge);
+    }
+    inline bool isBorder(unsigned edge) const { return getHalfEdges(edge).size() == 1; }
+    /** Edges from vertex to its neighbors of higher index, in increasing order */
+    inline unsigned getFirstEdge(unsigned vertex) const { return firstEdges[vertex]; }
+
+    /**
+     * Neighbors of vertex turning around it, fan after fan
+     * Open fans start from their border, closed ones from their first triangle.
+     */
+    void collectOrderedOneRing(unsigned vertex, std::vector<unsigned> &ring) const;
+
+private:
+    std::vector<unsigned> cornerVertices;
+    std::vector<unsigned> firstCorners;
+    std::vector<unsigned> corners;
+    std::vector<unsigned> firstNeighbors;
+    std::vector<unsigned> neighbors;
+    std::vector<unsigned> firstEdges;
+    std::vector<unsigned> edgeVertices;
+    std::vector<unsigned> halfEdgeEdges;
+    std::vector<unsigned> firstHalfEdges;
+    std::vector<unsigned> halfEdges;
+    std::vector<unsigned> twins;
+
+    static inline Range range(const std::vector<unsigned> &offsets, const std::vector<unsigned> &list,
+                              unsigned i) {
+        return Range(list.data() + offsets[i], list.data() + offsets[i+1]);
+    }
+
+    /** Group items 0..keys.size()-1 by key in offsets and list, keeping their order */
+    static void countingSort(const std::vector<unsigned> &keys, unsigned nbKeys,
+                             std::vector<unsigned> &offsets, std::vector<unsigned> &list);
+};
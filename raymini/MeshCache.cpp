@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+using namespace std;
+
+const char *MeshCache::EXTENSION = ".cache";
+
+bool MeshCache::enabled = true;
+
+static const uint32_t MESH_MAGIC = 0x31434d52;   // "RMC1"
+static const uint32_t KDTREE_MAGIC = 0x31444b52; // "RKD1"
+/**
+ * Changes with the format and with the layout of the stored structures
+ * Version 2 caps the depth of median split trees, see KDtreeBuilder::maxDepth.
+ */
+static const uint32_t VERSION = (2u << 24) |
+    (uint32_t(sizeof(PackedTriangles)) << 8) | uint32_t(sizeof(KDtree::Node));
+
+bool MeshCache::sourceHeader(const string &meshPath, Header &header) {
+    struct stat st;
+    if (stat(meshPath.c_str(), &st)) {
+        return false;
+    }
+    header = Header();
+    header.magic = MESH_MAGIC;
+    header.version = VERSION;
+    header.sourceSize = st.st_size;
+    header.sourceTime = st.st_mtim.tv_sec;
+    header.sourceTimeNsec = st.st_mtim.tv_nsec;
+    return true;
+}
+
+size_t MeshCache::meshSize(const Header &header) {
+    return sizeof(Header) +
+        header.nbVertices*6*sizeof(float) +
+        header.nbTriangles*(3*sizeof(uint32_t) + 6*sizeof(float));
+}
+
+const MeshCache::Header * MeshCache::mappedHeader(const MappedFile &file) {
+    if (!file.isMapped() || file.getSize() < sizeof(Header)) {
+        return nullptr;
+    }
+    const Header *header = reinterpret_cast<const Header *>(file.getData());
+    if (header->magic != MESH_MAGIC || header->version != VERSION ||
+        file.getSize() < meshSize(*header)) {
+        return nullptr;
+    }
+    return header;
+}
+
+size_t MeshCache::kdtreeSize(const KDtreeHeader &tree) {
+    return sizeof(tree) + tree.nbNodes*sizeof(KDtree::Node) + tree.nbPackets*sizeof(PackedTriangles);
+}
+
+bool MeshCache::checkKDtree(const KDtreeHeader &tree, const vector<KDtree::Node> &nodes) {
+    if (tree.maxDepth >= KDtree::MAX_DEPTH) {
+        return false;
+    }
+    // Children follow their parent in depth first order, so depths are known
+    // before reaching a node, and a corrupt tree cannot loop
+    vector<unsigned> depths(nodes.size(), 0);
+    for (unsigned i = 0; i < nodes.size(); i++) {
+        const KDtree::Node &node = nodes[i];
+        if (depths[i] >= KDtree::MAX_DEPTH) {
+            return false;
+        }
+        if (node.isLeaf()) {
+            if (node.getFirstTriangle() > tree.nbPackets ||
+                node.getNbPackets() > tree.nbPackets - node.getFirstTriangle()) {
+                return false;
+            }
+        }
+        else {
+            const unsigned above = node.getAboveChild();
+            if (above <= i+1 || above >= nodes.size()) {
+                return false;
+            }
+            depths[i+1] = max(depths[i+1], depths[i]+1);
+            depths[above] = max(depths[above], depths[i]+1);
+        }
+    }
+    return true;
+}
+
+bool MeshCache::loadMesh(const string &meshPath, Mesh &mesh) {
+    Header source;
+    if (!enabled || !sourceHeader(meshPath, source)) {
+        return false;
+    }
+    MappedFile file(getCachePath(meshPath));
+    const Header *header = mappedHeader(file);
+    if (!header || header->sourceSize != source.sourceSize ||
+        header->sourceTime != source.sourceTime || header->sourceTimeNsec != source.sourceTimeNsec) {
+        return false;
+    }
+
+    const float *vertexData = reinterpret_cast<const float *>(header+1);
+    const uint32_t *indices = reinterpret_cast<const uint32_t *>(vertexData + 6*header->nbVertices);
+    const float *uvs = reinterpret_cast<const float *>(indices + 3*header->nbTriangles);
+    // A corrupt cache of the right size would index vertices out of bounds when rendering
+    for (size_t i = 0; i < 3*size_t(header->nbTriangles); i++) {
+        if (indices[i] >= header->nbVertices) {
+            return false;
+        }
+    }
+
+    vector<Vertex> &vertices = mesh.getVertices();
+    vertices.resize(header->nbVertices);
+    for (unsigned i = 0; i < header->nbVertices; i++) {
+        const float *v = vertexData + 6*i;
+        vertices[i] = Vertex(Vec3Df(v[0], v[1], v[2]), Vec3Df(v[3], v[4], v[5]));
+    }
+    vector<Triangle> &triangles = mesh.getTriangles();
+    triangles.resize(header->nbTriangles);
+    for (unsigned t = 0; t < header->nbTriangles; t++) {
+        triangles[t] = Triangle(indices + 3*t);
+        for (unsigned k = 0; k < 3; k++) {
+            triangles[t].setUV(k, uvs[6*t+2*k], uvs[6*t+2*k+1]);
+        }
+    }
+    mesh.invalidateAdjacency();
+    return true;
+}
+
+bool MeshCache::saveMesh(const string &meshPath, const Mesh &mesh) {
+    Header header;
+    if (!enabled || !sourceHeader(meshPath, header)) {
+        return false;
+    }
+    const vector<Vertex> &vertices = mesh.getVertices();
+    const vector<Triangle> &triangles = mesh.getTriangles();
+    header.nbVertices = vertices.size();
+    header.nbTriangles = triangles.size();
+
+    vector<float> vertexData(6*vertices.size());
+    for (unsigned i = 0; i < vertices.size(); i++) {
+        for (unsigned k = 0; k < 3; k++) {
+            vertexData[6*i+k] = vertices[i].getPos()[k];
+            vertexData[6*i+3+k] = vertices[i].getNormal()[k];
+        }
+    }
+    vector<uint32_t> indices(3*triangles.size());
+    vector<float> uvs(6*triangles.size());
+    for (unsigned t = 0; t < triangles.size(); t++) {
+        for (unsigned k = 0; k < 3; k++) {
+            indices[3*t+k] = triangles[t].getVertex(k);
+            uvs[6*t+2*k] = triangles[t].getU(k);
+            uvs[6*t+2*k+1] = triangles[t].getV(k);
+        }
+    }
+
+    // Written aside then renamed, so that a cache is never read half written
+    const string path = getCachePath(meshPath);
+    const string tmpPath = path + ".tmp";
+    {
+        ofstream output(tmpPath.c_str(), ios::binary | ios::trunc);
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char *>(vertexData.data()), vertexData.size()*sizeof(float));
+        output.write(reinterpret_cast<const char *>(indices.data()), indices.size()*sizeof(uint32_t));
+        output.write(reinterpret_cast<const char *>(uvs.data()), uvs.size()*sizeof(float));
+        if (!output) {
+            output.close();
+            remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+uint64_t MeshCache::hashGeometry(const Mesh &mesh) {
+    // FNV-1a on 32 bits words
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](uint32_t word) {
+        hash = (hash ^ word) * 1099511628211ull;
+    };
+    for (const Vertex &v : mesh.getVertices()) {
+        for (unsigned k = 0; k < 3; k++) {
+            uint32_t word;
+            memcpy(&word, &v.getPos()[k], sizeof(word));
+            add(word);
+        }
+    }
+    for (const Triangle &t : mesh.getTriangles()) {
+        for (unsigned k = 0; k < 3; k++) {
+            add(t.getVertex(k));
+        }
+    }
+    add(mesh.getVertices().size());
+    add(mesh.getTriangles().size());
+    return hash;
+}
+
+bool MeshCache::loadKDtree(const string &cachePath, uint64_t hash, KDtree::Split split,
+                           vector<KDtree::Node> &nodes, vector<PackedTriangles> &triangles,
+                           KDtree::Stats &stats) {
+    if (!enabled) {
+        return false;
+    }
+    MappedFile file(cachePath);
+    const Header *header = mappedHeader(file);
+    if (!header) {
+        return false;
+    }
+
+    // Trees follow the mesh one after the other
+    size_t offset = meshSize(*header);
+    while (offset + sizeof(KDtreeHeader) <= file.getSize()) {
+        KDtreeHeader tree;
+        memcpy(&tree, file.getData() + offset, sizeof(tree));
+        const size_t size = kdtreeSize(tree);
+        if (tree.magic != KDTREE_MAGIC || offset + size > file.getSize()) {
+            return false;
+        }
+        if (tree.hash == hash && tree.split == uint32_t(split)) {
+            const char *data = file.getData() + offset + sizeof(tree);
+            nodes.resize(tree.nbNodes);
+            memcpy(nodes.data(), data, tree.nbNodes*sizeof(KDtree::Node));
+            // A corrupt tree would make traversals read out of bounds, saveKDtree replaces it
+            if (!checkKDtree(tree, nodes)) {
+                nodes.clear();
+                return false;
+            }
+            triangles.resize(tree.nbPackets);
+            memcpy(triangles.data(), data + tree.nbNodes*sizeof(KDtree::Node),
+                   tree.nbPackets*sizeof(PackedTriangles));
+            stats.nbNodes = tree.nbNodes;
+            stats.nbLeaves = tree.nbLeaves;
+            stats.nbReferences = tree.nbReferences;
+            stats.maxDepth = tree.maxDepth;
+            return true;
+        }
+        offset += size;
+    }
+    return false;
+}
+
+void MeshCache::saveKDtree(const string &cachePath, uint64_t hash, KDtree::Split split,
+                           const vector<KDtree::Node> &nodes, const vector<PackedTriangles> &triangles,
+                           const KDtree::Stats &stats) {
+    if (!enabled) {
+        return;
+    }
+    size_t offset, fileSize;
+    {
+        MappedFile file(cachePath);
+        const Header *header = mappedHeader(file);
+        if (!header) {
+            return;
+        }
+        // Trees are kept up to the first one cut short by a failed write or
+        // rejected by loadKDtree, which is the only way to get one for this
+        // geometry and split here; that one and the following are dropped
+        unsigned nbTrees = 0;
+        offset = meshSize(*header);
+        fileSize = file.getSize();
+        while (offset + sizeof(KDtreeHeader) <= fileSize) {
+            KDtreeHeader tree;
+            memcpy(&tree, file.getData() + offset, sizeof(tree));
+            const size_t size = kdtreeSize(tree);
+            if (tree.magic != KDTREE_MAGIC || offset + size > fileSize ||
+                (tree.hash == hash && tree.split == uint32_t(split))) {
+                break;
+            }
+            offset += size;
+            nbTrees++;
+        }
+        if (nbTrees >= MAX_KDTREES) {
+            return;
+        }
+    }
+    if (offset != fileSize && truncate(cachePath.c_str(), offset)) {
+        return;
+    }
+
+    KDtreeHeader tree = KDtreeHeader();
+    tree.magic = KDTREE_MAGIC;
+    tree.split = split;
+    tree.hash = hash;
+    tree.nbNodes = nodes.size();
+    tree.nbPackets = triangles.size();
+    tree.nbLeaves = stats.nbLeaves;
+    tree.nbReferences = stats.nbReferences;
+    tree.maxDepth = stats.maxDepth;
+
+    // A tree cut short by a failed write is ignored by loadKDtree, then dropped here
+    ofstream output(cachePath.c_str(), ios::binary | ios::app);
+    output.write(reinterpret_cast<const char *>(&tree), sizeof(tree));
+    output.write(reinterpret_cast<const char *>(nodes.data()), nodes.size()*sizeof(KDtree::Node));
+    output.write(reinterpret_cast<const char *>(triangles.data()), triangles.size()*sizeof(PackedTriangles));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "KDtree.h"
+
+class MappedFile;
+class Mesh;
+
+/**
+ * Binary cache of mesh files, written next to them as <file>.cache
+ *
+ * It holds the loaded mesh (positions, normals, texture coordinates and
+ * triangles) followed by KDtrees built for it, and is read back through
+ * mmap with plain copies.
+ * The cache is rewritten when the size or modification time of the mesh
+ * file changes. Each KDtree is stored with a hash of the geometry it was
+ * built for, so that transformed copies of the mesh get their own tree.
+ */
+class MeshCache {
+public:
+    static const char *EXTENSION;
+    /** Trees kept for one mesh, later ones are rebuilt on every launch */
+    static const unsigned MAX_KDTREES = 8;
+
+    /** Caches are neither read nor written if false */
+    static bool enabled;
+
+    static inline std::string getCachePath(const std::string &meshPath) { return meshPath + EXTENSION; }
+
+    /** Fill mesh from the cache of meshPath, false if it is missing, stale or corrupt */
+    static bool loadMesh(const std::string &meshPath, Mesh &mesh);
+    /** Write the cache of meshPath for mesh, which has just been loaded from it */
+    static bool saveMesh(const std::string &meshPath, const Mesh &mesh);
+
+    /** Hash of the vertex positions and triangles of mesh */
+    static uint64_t hashGeometry(const Mesh &mesh);
+
+    /** Tree cached for the geometry hash and split, false if there is none */
+    static bool loadKDtree(const std::string &cachePath, uint64_t hash, KDtree::Split split,
+                           std::vector<KDtree::Node> &nodes, std::vector<PackedTriangles> &triangles,
+                           KDtree::Stats &stats);
+    /** Append a tree to the cache */
+    static void saveKDtree(const std::string &cachePath, uint64_t hash, KDtree::Split split,
+                           const std::vector<KDtree::Node> &nodes,
+                           const std::vector<PackedTriangles> &triangles,
+                           const KDtree::Stats &stats);
+
+private:
+    class Header {
+    public:
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        int64_t sourceTimeNsec;
+        uint32_t nbVertices;
+        uint32_t nbTriangles;
+    };
+
+    class KDtreeHeader {
+    public:
+        uint32_t magic;
+        uint32_t split;
+        uint64_t hash;
+        uint32_t nbNodes;
+        uint32_t nbPackets;
+        uint32_t nbLeaves;
+        uint32_t nbReferences;
+        uint32_t maxDepth;
+        uint32_t padding;
+    };
+
+    /** Header of the current version for the mesh file, false if it cannot be read */
+    static bool sourceHeader(const std::string &meshPath, Header &header);
+    /** Size of the mesh part of a cache */
+    static size_t meshSize(const Header &header);
+    /** Mapping of a cache with a valid header, null otherwise */
+    static const Header * mappedHeader(const MappedFile &file);
+    /** Size of a cached tree, header included */
+    static size_t kdtreeSize(const KDtreeHeader &tree);
+    /** False if nodes of tree reference nodes or packets out of it, or are too deep to traverse */
+    static bool checkKDtree(const KDtreeHeader &tree, const std::vector<KDtree::Node> &nodes);
+};
@@ -0,0 +1,703 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+using namespace std;
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char * skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline bool tokenEnds(const char *p, const char *end) {
+    return p == end || isSpace(*p);
+}
+
+/** End of the line starting at p, on its '\n' or at end */
+static inline const char * lineEnd(const char *p, const char *end) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+/** Lines which are neither blank nor comments */
+static inline bool isRecord(const char *p, const char *end) {
+    p = skipSpaces(p, end);
+    return p < end && *p != '#';
+}
+
+/** End of the token p is in */
+static inline const char * tokenEnd(const char *p, const char *end) {
+    while (p < end && !isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char * skipToken(const char *p, const char *end) {
+    return tokenEnd(skipSpaces(p, end), end);
+}
+
+static unsigned countTokens(const char *p, const char *end) {
+    unsigned count = 0;
+    for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end)) {
+        p = skipToken(p, end);
+        count++;
+    }
+    return count;
+}
+
+/** Read a whole float token, with the rounding of strtof */
+static bool parseFloat(const char *&p, const char *end, float &value) {
+    p = skipSpaces(p, end);
+    char buffer[64];
+    size_t n = 0;
+    while (p < end && !isSpace(*p) && n < sizeof(buffer) - 1) {
+        buffer[n++] = *p++;
+    }
+    if (n == 0 || !tokenEnds(p, end)) {
+        return false;
+    }
+    buffer[n] = 0;
+    char *stop;
+    value = strtof(buffer, &stop);
+    return stop == buffer + n;
+}
+
+/** Read the leading integer of a token, the rest of the token is left */
+static bool parseInt(const char *&p, const char *end, long &value) {
+    p = skipSpaces(p, end);
+    const bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    const char *digits = p;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = 10*value + (*p++ - '0');
+    }
+    if (negative) {
+        value = -value;
+    }
+    return p != digits;
+}
+
+/** Read one polygon of size indices of parse and append its fan to triangles */
+template<class Parse>
+static bool parsePolygon(unsigned size, vector<Triangle> &triangles, Parse parse) {
+    unsigned first = 0, previous = 0;
+    for (unsigned j = 0; j < size; j++) {
+        unsigned index;
+        if (!parse(index)) {
+            return false;
+        }
+        if (j == 0) {
+            first = index;
+        }
+        else if (j >= 2) {
+            triangles.push_back(Triangle(first, previous, index));
+        }
+        previous = index;
+    }
+    return true;
+}
+
+static void stitch(vector<vector<Triangle>> &parts, vector<Triangle> &triangles) {
+    vector<size_t> offsets(parts.size()+1, 0);
+    for (unsigned c = 0; c < parts.size(); c++) {
+        offsets[c+1] = offsets[c] + parts[c].size();
+    }
+    triangles.resize(offsets.back());
+    #pragma omp parallel for
+    for (unsigned c = 0; c < parts.size(); c++) {
+        copy(parts[c].begin(), parts[c].end(), triangles.begin() + offsets[c]);
+        vector<Triangle>().swap(parts[c]);
+    }
+}
+
+/**
+ * Parse the records of chunks in parallel
+ *
+ * parse(record, begin, end, triangles) reads the record of index record on
+ * the line [begin, end) and appends its triangles, which are gathered in
+ * the order of the file. Returns the number of records.
+ */
+template<class Chunk, class Parse>
+static unsigned parseRecords(const vector<Chunk> &chunks, vector<Triangle> &triangles, Parse parse) {
+    const unsigned nbChunks = chunks.size();
+    vector<unsigned> firstRecords(nbChunks+1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned c = 0; c < nbChunks; c++) {
+        unsigned nbRecords = 0;
+        for (const char *p = chunks[c].begin; p < chunks[c].end;) {
+            const char *eol = lineEnd(p, chunks[c].end);
+            if (isRecord(p, eol)) {
+                nbRecords++;
+            }
+            p = eol + 1;
+        }
+        firstRecords[c+1] = nbRecords;
+    }
+    partial_sum(firstRecords.begin(), firstRecords.end(), firstRecords.begin());
+
+    vector<vector<Triangle>> chunkTriangles(nbChunks);
+    vector<char> failed(nbChunks, false);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned c = 0; c < nbChunks; c++) {
+        unsigned record = firstRecords[c];
+        for (const char *p = chunks[c].begin; p < chunks[c].end;) {
+            const char *eol = lineEnd(p, chunks[c].end);
+            if (isRecord(p, eol)) {
+                if (!parse(record, p, eol, chunkTriangles[c])) {
+                    failed[c] = true;
+                    break;
+                }
+                record++;
+            }
+            p = eol + 1;
+        }
+    }
+    if (find(failed.begin(), failed.end(), true) != failed.end()) {
+        throw Mesh::Exception("Invalid line in the file.");
+    }
+    stitch(chunkTriangles, triangles);
+    return firstRecords.back();
+}
+
+/** Extension of filename with its dot, in lower case */
+static string getExtension(const string &filename) {
+    string extension = filename.substr(min(filename.size(), filename.rfind('.')));
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+void MeshLoader::load(const string &filename, vector<Vertex> &vertices, vector<Triangle> &triangles) {
+    const string extension = getExtension(filename);
+    if (!isSupported(filename)) {
+        throw Mesh::Exception("Unknown mesh format.");
+    }
+    MappedFile file(filename);
+    if (!file.isMapped()) {
+        throw Mesh::Exception("Failing opening the file.");
+    }
+    const char *begin = file.getData();
+    const char *end = begin + file.getSize();
+    vertices.clear();
+    triangles.clear();
+    if (extension == ".off") {
+        loadOFF(begin, end, vertices, triangles);
+    }
+    else if (extension == ".obj") {
+        loadOBJ(begin, end, vertices, triangles);
+    }
+    else {
+        loadPLY(begin, end, vertices, triangles);
+    }
+}
+
+bool MeshLoader::isSupported(const string &filename) {
+    const string extension = getExtension(filename);
+    return extension == ".off" || extension == ".ply" || extension == ".obj";
+}
+
+vector<MeshLoader::Chunk> MeshLoader::splitLines(const char *begin, const char *end) {
+    vector<Chunk> chunks;
+    while (begin < end) {
+        const char *stop = begin + min(size_t(CHUNK_SIZE), size_t(end - begin));
+        if (stop < end) {
+            stop = lineEnd(stop, end);
+            stop = min(stop + 1, end);
+        }
+        chunks.push_back({begin, stop});
+        begin = stop;
+    }
+    return chunks;
+}
+
+void MeshLoader::loadOFF(const char *begin, const char *end,
+                         vector<Vertex> &vertices, vector<Triangle> &triangles) {
+    // Magic word and counts may be spread over several lines
+    const char *p = begin;
+    bool magic = false;
+    vector<long> counts;
+    while (counts.size() < 3 && p < end) {
+        const char *eol = lineEnd(p, end);
+        const char *q = skipSpaces(p, eol);
+        if (q < eol && *q != '#') {
+            if (!magic) {
+                if (eol - q < 3 || strncmp(q, "OFF", 3) || !tokenEnds(q+3, eol)) {
+                    throw Mesh::Exception("Not an OFF file.");
+                }
+                q += 3;
+                magic = true;
+            }
+            long count;
+            while (counts.size() < 3 && parseInt(q, eol, count) && tokenEnds(q, eol)) {
+                counts.push_back(count);
+            }
+        }
+        p = eol + 1;
+    }
+    if (counts.size() < 3 || counts[0] < 0 || counts[1] < 0) {
+        throw Mesh::Exception("Invalid OFF header.");
+    }
+    const unsigned nbVertices = counts[0];
+    const unsigned nbFaces = counts[1];
+
+    vertices.resize(nbVertices);
+    auto parse = [&](unsigned record, const char *p, const char *end, vector<Triangle> &chunkTriangles) {
+        if (record < nbVertices) {
+            Vec3Df pos;
+            for (unsigned k = 0; k < 3; k++) {
+                if (!parseFloat(p, end, pos[k])) {
+                    return false;
+                }
+            }
+            vertices[record] = Vertex(pos, Vec3Df(1.0, 0.0, 0.0));
+            return true;
+        }
+        if (record >= nbVertices + nbFaces) {
+            return true;
+        }
+        long size;
+        if (!parseInt(p, end, size) || !tokenEnds(p, end) || size < 0) {
+            return false;
+        }
+        return parsePolygon(size, chunkTriangles, [&](unsigned &index) {
+            long i;
+            if (!parseInt(p, end, i) || !tokenEnds(p, end) || i < 0 || i >= long(nbVertices)) {
+                return false;
+            }
+            index = i;
+            return true;
+        });
+    };
+    if (parseRecords(splitLines(min(p, end), end), triangles, parse) < nbVertices + nbFaces) {
+        throw Mesh::Exception("Truncated OFF file.");
+    }
+}
+
+void MeshLoader::loadOBJ(const char *begin, const char *end,
+                         vector<Vertex> &vertices, vector<Triangle> &triangles) {
+    const vector<Chunk> chunks = splitLines(begin, end);
+    const unsigned nbChunks = chunks.size();
+
+    // Counting first gives each chunk the index of its first vertex and
+    // triangle, which relative face indices also need
+    vector<unsigned> firstVertices(nbChunks+1, 0);
+    vector<unsigned> firstTriangles(nbChunks+1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned c = 0; c < nbChunks; c++) {
+        unsigned nbVertices = 0, nbTriangles = 0;
+        for (const char *p = chunks[c].begin; p < chunks[c].end;) {
+            const char *eol = lineEnd(p, chunks[c].end);
+            const char *q = skipSpaces(p, eol);
+            if (q < eol && *q == 'v' && tokenEnds(q+1, eol)) {
+                nbVertices++;
+            }
+            else if (q < eol && *q == 'f' && tokenEnds(q+1, eol)) {
+                const unsigned size = countTokens(q+1, eol);
+                nbTriangles += size > 2 ? size - 2 : 0;
+            }
+            p = eol + 1;
+        }
+        firstVertices[c+1] = nbVertices;
+        firstTriangles[c+1] = nbTriangles;
+    }
+    partial_sum(firstVertices.begin(), firstVertices.end(), firstVertices.begin());
+    partial_sum(firstTriangles.begin(), firstTriangles.end(), firstTriangles.begin());
+    const long nbVertices = firstVertices.back();
+    vertices.resize(nbVertices);
+    triangles.resize(firstTriangles.back());
+
+    vector<char> failed(nbChunks, false);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned c = 0; c < nbChunks; c++) {
+        unsigned vertex = firstVertices[c];
+        vector<Triangle> polygon;
+        for (const char *p = chunks[c].begin; p < chunks[c].end && !failed[c];) {
+            const char *eol = lineEnd(p, chunks[c].end);
+            const char *q = skipSpaces(p, eol);
+            if (q < eol && *q == 'v' && tokenEnds(q+1, eol)) {
+                q++;
+                Vec3Df pos;
+                for (unsigned k = 0; k < 3; k++) {
+                    if (!parseFloat(q, eol, pos[k])) {
+                        failed[c] = true;
+                    }
+                }
+                vertices[vertex++] = Vertex(pos, Vec3Df(1.0, 0.0, 0.0));
+            }
+            else if (q < eol && *q == 'f' && tokenEnds(q+1, eol)) {
+                q++;
+                polygon.clear();
+                // Tokens are v, v/vt, v//vn or v/vt/vn, negative indices count back from the last vertex
+                failed[c] = !parsePolygon(countTokens(q, eol), polygon, [&](unsigned &index) {
+                    long i;
+                    if (!parseInt(q, eol, i)) {
+                        return false;
+                    }
+                    i = i < 0 ? long(vertex) + i : i - 1;
+                    q = tokenEnd(q, eol);
+                    index = i;
+                    return i >= 0 && i < nbVertices;
+                });
+                copy(polygon.begin(), polygon.end(), triangles.begin() + firstTriangles[c]);
+                firstTriangles[c] += polygon.size();
+            }
+            p = eol + 1;
+        }
+    }
+    if (find(failed.begin(), failed.end(), true) != failed.end()) {
+        throw Mesh::Exception("Invalid line in the OBJ file.");
+    }
+}
+
+/** Scalar types of PLY properties */
+enum PlyType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+static const unsigned PLY_SIZES[] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+class PlyProperty {
+public:
+    std::string name;
+    bool list;
+    PlyType countType;
+    PlyType type;
+};
+
+class PlyElement {
+public:
+    std::string name;
+    unsigned count;
+    std::vector<PlyProperty> properties;
+
+    /** Size of one element in a binary file, 0 if it holds lists */
+    unsigned getSize() const {
+        unsigned size = 0;
+        for (const PlyProperty &property : properties) {
+            if (property.list) {
+                return 0;
+            }
+            size += PLY_SIZES[property.type];
+        }
+        return size;
+    }
+};
+
+static bool parsePlyType(const string &name, PlyType &type) {
+    static const char *NAMES[][2] = {
+        {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+        {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"}
+    };
+    for (unsigned t = 0; t <= PLY_FLOAT64; t++) {
+        if (name == NAMES[t][0] || name == NAMES[t][1]) {
+            type = PlyType(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class T>
+static inline T readRaw(const char *p, bool swap) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, p, sizeof(T));
+    if (swap) {
+        reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+static double readPly(const char *p, PlyType type, bool swap) {
+    switch (type) {
+    case PLY_INT8: return readRaw<int8_t>(p, swap);
+    case PLY_UINT8: return readRaw<uint8_t>(p, swap);
+    case PLY_INT16: return readRaw<int16_t>(p, swap);
+    case PLY_UINT16: return readRaw<uint16_t>(p, swap);
+    case PLY_INT32: return readRaw<int32_t>(p, swap);
+    case PLY_UINT32: return readRaw<uint32_t>(p, swap);
+    case PLY_FLOAT32: return readRaw<float>(p, swap);
+    default: return readRaw<double>(p, swap);
+    }
+}
+
+static inline bool isFaceIndices(const PlyProperty &property) {
+    return property.list && (property.name == "vertex_indices" || property.name == "vertex_index");
+}
+
+void MeshLoader::loadPLY(const char *begin, const char *end,
+                         vector<Vertex> &vertices, vector<Triangle> &triangles) {
+    const char *p = lineEnd(begin, end);
+    if (string(skipSpaces(begin, p), skipToken(begin, p)) != "ply") {
+        throw Mesh::Exception("Not a PLY file.");
+    }
+    p++;
+    string format;
+    vector<PlyElement> elements;
+    for (bool header = true; header;) {
+        if (p >= end) {
+            throw Mesh::Exception("Truncated PLY header.");
+        }
+        const char *eol = lineEnd(p, end);
+        istringstream line(string(p, eol));
+        p = eol + 1;
+        string keyword;
+        line >> keyword;
+        if (keyword == "format") {
+            line >> format;
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            line >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            if (elements.empty()) {
+                throw Mesh::Exception("Invalid PLY header.");
+            }
+            PlyProperty property;
+            string type;
+            line >> type;
+            property.list = type == "list";
+            property.countType = PLY_UINT8;
+            if (property.list) {
+                string countType;
+                line >> countType >> type;
+                if (!parsePlyType(countType, property.countType)) {
+                    throw Mesh::Exception("Invalid PLY property type.");
+                }
+            }
+            if (!parsePlyType(type, property.type)) {
+                throw Mesh::Exception("Invalid PLY property type.");
+            }
+            line >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") {
+            header = false;
+        }
+    }
+    p = min(p, end);
+
+    unsigned nbVertices = 0;
+    int coordinates[3] = {-1, -1, -1};
+    for (const PlyElement &element : elements) {
+        if (element.name != "vertex") {
+            continue;
+        }
+        nbVertices = element.count;
+        for (unsigned i = 0; i < element.properties.size(); i++) {
+            const string &name = element.properties[i].name;
+            if (name.size() == 1 && name[0] >= 'x' && name[0] <= 'z' && !element.properties[i].list) {
+                coordinates[name[0] - 'x'] = i;
+            }
+        }
+    }
+    if (coordinates[0] < 0 || coordinates[1] < 0 || coordinates[2] < 0) {
+        throw Mesh::Exception("PLY file without vertex positions.");
+    }
+    vertices.resize(nbVertices);
+
+    if (format == "ascii") {
+        // Every element takes one line, elements follow each other
+        vector<unsigned> firstRecords(1, 0);
+        for (const PlyElement &element : elements) {
+            firstRecords.push_back(firstRecords.back() + element.count);
+        }
+        auto parse = [&](unsigned record, const char *p, const char *end, vector<Triangle> &chunkTriangles) {
+            const unsigned e = upper_bound(firstRecords.begin(), firstRecords.end(), record) - firstRecords.begin() - 1;
+            if (e >= elements.size()) {
+                return true;
+            }
+            const PlyElement &element = elements[e];
+            const bool isVertex = element.name == "vertex";
+            const bool isFace = element.name == "face";
+            if (!isVertex && !isFace) {
+                return true;
+            }
+            Vec3Df pos;
+            for (unsigned i = 0; i < element.properties.size(); i++) {
+                const PlyProperty &property = element.properties[i];
+                if (!property.list) {
+                    float value;
+                    if (!parseFloat(p, end, value)) {
+                        return false;
+                    }
+                    for (unsigned k = 0; k < 3; k++) {
+                        if (isVertex && coordinates[k] == int(i)) {
+                            pos[k] = value;
+                        }
+                    }
+                    continue;
+                }
+                long size;
+                if (!parseInt(p, end, size) || !tokenEnds(p, end) || size < 0) {
+                    return false;
+                }
+                if (isFace && isFaceIndices(property)) {
+                    if (!parsePolygon(size, chunkTriangles, [&](unsigned &index) {
+                        long v;
+                        if (!parseInt(p, end, v) || !tokenEnds(p, end) || v < 0 || v >= long(nbVertices)) {
+                            return false;
+                        }
+                        index = v;
+                        return true;
+                    })) {
+                        return false;
+                    }
+                }
+                else {
+                    for (long j = 0; j < size; j++) {
+                        p = skipToken(p, end);
+                    }
+                }
+            }
+            if (isVertex) {
+                vertices[record - firstRecords[e]] = Vertex(pos, Vec3Df(1.0, 0.0, 0.0));
+            }
+            return true;
+        };
+        if (parseRecords(splitLines(p, end), triangles, parse) < firstRecords.back()) {
+            throw Mesh::Exception("Truncated PLY file.");
+        }
+        return;
+    }
+
+    if (format != "binary_little_endian" && format != "binary_big_endian") {
+        throw Mesh::Exception("Unknown PLY format.");
+    }
+    const uint16_t one = 1;
+    const bool littleEndian = *reinterpret_cast<const char *>(&one) == 1;
+    const bool swap = littleEndian != (format == "binary_little_endian");
+    // Offset of the next list after p, 0 if it goes past the end of the file
+    auto listSize = [&](const char *p, const PlyProperty &property) -> size_t {
+        if (p + PLY_SIZES[property.countType] > end) {
+            return 0;
+        }
+        const double size = readPly(p, property.countType, swap);
+        const size_t bytes = PLY_SIZES[property.countType] + size_t(max(size, 0.))*PLY_SIZES[property.type];
+        return p + bytes <= end ? bytes : 0;
+    };
+
+    for (const PlyElement &element : elements) {
+        const unsigned size = element.getSize();
+        if (size && p + size_t(size)*element.count > end) {
+            throw Mesh::Exception("Truncated PLY file.");
+        }
+
+        if (element.name == "vertex") {
+            if (!size) {
+                throw Mesh::Exception("PLY vertices with lists are not supported.");
+            }
+            unsigned offsets[3];
+            for (unsigned k = 0; k < 3; k++) {
+                offsets[k] = 0;
+                for (int i = 0; i < coordinates[k]; i++) {
+                    offsets[k] += PLY_SIZES[element.properties[i].type];
+                }
+            }
+            #pragma omp parallel for
+            for (unsigned v = 0; v < element.count; v++) {
+                const char *data = p + size_t(size)*v;
+                Vec3Df pos;
+                for (unsigned k = 0; k < 3; k++) {
+                    pos[k] = readPly(data + offsets[k], element.properties[coordinates[k]].type, swap);
+                }
+                vertices[v] = Vertex(pos, Vec3Df(1.0, 0.0, 0.0));
+            }
+            p += size_t(size)*element.count;
+            continue;
+        }
+
+        if (size) {
+            p += size_t(size)*element.count;
+            continue;
+        }
+
+        // Lists make the size of elements vary, so they are first scanned
+        // by blocks, then each block is read in parallel
+        const bool isFace = element.name == "face";
+        const unsigned BLOCK_SIZE = 1 << 14;
+        vector<const char *> blocks;
+        vector<size_t> firstTriangles;
+        size_t nbTriangles = 0;
+        for (unsigned f = 0; f < element.count; f++) {
+            if (f % BLOCK_SIZE == 0) {
+                blocks.push_back(p);
+                firstTriangles.push_back(nbTriangles);
+            }
+            for (const PlyProperty &property : element.properties) {
+                if (!property.list) {
+                    p += PLY_SIZES[property.type];
+                    if (p > end) {
+                        throw Mesh::Exception("Truncated PLY file.");
+                    }
+                    continue;
+                }
+                const size_t bytes = listSize(p, property);
+                if (!bytes) {
+                    throw Mesh::Exception("Truncated PLY file.");
+                }
+                if (isFace && isFaceIndices(property)) {
+                    const size_t n = (bytes - PLY_SIZES[property.countType])/PLY_SIZES[property.type];
+                    nbTriangles += n > 2 ? n - 2 : 0;
+                }
+                p += bytes;
+            }
+        }
+        if (!isFace) {
+            continue;
+        }
+
+        triangles.resize(nbTriangles);
+        const unsigned nbBlocks = blocks.size();
+        vector<char> failed(nbBlocks, false);
+        #pragma omp parallel for schedule(dynamic)
+        for (unsigned b = 0; b < nbBlocks; b++) {
+            const char *data = blocks[b];
+            vector<Triangle> polygon;
+            Triangle *output = triangles.data() + firstTriangles[b];
+            const unsigned last = min(element.count, (b+1)*BLOCK_SIZE);
+            for (unsigned f = b*BLOCK_SIZE; f < last && !failed[b]; f++) {
+                for (const PlyProperty &property : element.properties) {
+                    if (!property.list) {
+                        data += PLY_SIZES[property.type];
+                        continue;
+                    }
+                    const size_t bytes = listSize(data, property);
+                    if (isFaceIndices(property)) {
+                        const unsigned n = (bytes - PLY_SIZES[property.countType])/PLY_SIZES[property.type];
+                        const char *item = data + PLY_SIZES[property.countType];
+                        polygon.clear();
+                        failed[b] = !parsePolygon(n, polygon, [&](unsigned &index) {
+                            const double v = readPly(item, property.type, swap);
+                            item += PLY_SIZES[property.type];
+                            index = v;
+                            return v >= 0 && v < nbVertices;
+                        });
+                        output = copy(polygon.begin(), polygon.end(), output);
+                    }
+                    data += bytes;
+                }
+            }
+        }
+        if (find(failed.begin(), failed.end(), true) != failed.end()) {
+            throw Mesh::Exception("Invalid face in the PLY file.");
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+/**
+ * Parallel reader of OFF, PLY (ASCII and binary) and OBJ meshes
+ *
+ * The file is mapped and cut into chunks of about CHUNK_SIZE bytes on line
+ * boundaries. Chunks are first counted, so that every vertex and triangle
+ * gets its final index, then parsed in parallel straight into storage
+ * reserved up front.
+ * Only vertex positions and faces are read, polygons are split in fans.
+ * Errors are thrown as Mesh::Exception.
+ */
+class MeshLoader {
+public:
+    static const size_t CHUNK_SIZE = 1 << 20;
+
+    /** Read filename, its format is given by its extension */
+    static void load(const std::string &filename,
+                     std::vector<Vertex> &vertices, std::vector<Triangle> &triangles);
+
+    /** True if the extension of filename is one of a supported format */
+    static bool isSupported(const std::string &filename);
+
+private:
+    /** Part of the file, from begin to end */
+    class Chunk {
+    public:
+        const char *begin;
+        const char *end;
+    };
+
+    /** Cut [begin, end) in chunks of about CHUNK_SIZE bytes, ending on line ends */
+    static std::vector<Chunk> splitLines(const char *begin, const char *end);
+
+    static void loadOFF(const char *begin, const char *end,
+                        std::vector<Vertex> &vertices, std::vector<Triangle> &triangles);
+    static void loadOBJ(const char *begin, const char *end,
+                        std::vector<Vertex> &vertices, std::vector<Triangle> &triangles);
+    static void loadPLY(const char *begin, const char *end,
+                        std::vector<Vertex> &vertices, std::vector<Triangle> &triangles);
+};
@@ -25,6 +25,7 @@ BoundingBox Object::computeBoundingBox(const Mesh & mesh) {
 }
 
 void Object::updateKDtree() {
+    updateRenderMesh();
     updateBoundingBox();
     if (tree) {
         delete tree;
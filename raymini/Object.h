@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "Mesh.h"
+#include "RenderMesh.h"
 #include "BoundingBox.h"
 #include "KDtree.h"
 #include "Brdf.h"
@@ -25,7 +26,7 @@ public:
     Object(const Mesh & mesh, const Material * mat, std::string name="No name",
            const Vec3Df &trans=Vec3Df(), const Vec3Df &mobile=Vec3Df()):
         NamedClass(name),
-        mesh (mesh), mat (mat), trans(trans), origTrans(trans),
+        mesh (mesh), mat (mat), renderMesh(mesh), trans(trans),
         tree(nullptr), mobile(mobile), enabled(true) {
         updateBoundingBox ();
         tree = new KDtree(*this);
@@ -36,20 +37,19 @@ public:
     }
 
     inline const Vec3Df & getTrans () const { return trans;}
-    inline void setTrans (const Vec3Df & t) {
-        trans = t;
-        origTrans = trans;
-    }
-
-    inline void move(unsigned nbImages) { trans += mobile/nbImages ; }
-    inline void reset() { trans = origTrans; }
+    /** Translation at time in [0, 1[: mobile objects move by mobile during a picture */
+    inline Vec3Df getTrans (float time) const { return trans + time*mobile; }
+    inline void setTrans (const Vec3Df & t) { trans = t; }
 
     inline bool isMobile() const {return mobile!=Vec3Df(); }
     inline void setMobile(const Vec3Df & mobile) { this->mobile = mobile; }
     inline Vec3Df getMobile() const {return mobile;}
 
     inline const Mesh & getMesh () const { return mesh; }
+    /** Call updateRenderMesh or updateKDtree after editing it */
     inline Mesh & getMesh () { return mesh; }
+    /** Mesh as read by rays */
+    inline const RenderMesh & getRenderMesh () const { return renderMesh; }
 
     inline const Material & getMaterial () const { return *mat; }
     inline void setMaterial(const Material *material) {mat = material;}
@@ -60,19 +60,28 @@ public:
     inline bool isEnabled() const { return enabled; }
 
     inline const BoundingBox & getBoundingBox () const { return bbox; }
+    /** World space box of the object over its whole motion */
+    inline BoundingBox getMotionBoundingBox () const {
+        BoundingBox b = bbox.translate(trans);
+        b.extendTo(bbox.translate(trans+mobile));
+        return b;
+    }
     void updateBoundingBox () { bbox = computeBoundingBox(mesh); }
     static BoundingBox computeBoundingBox(const Mesh & mesh);
 
+    /** After the texture mapping of the mesh changed */
+    void updateRenderMesh() { renderMesh = RenderMesh(mesh); }
+    /** After the geometry of the mesh changed */
     void updateKDtree();
 
 protected:
     Mesh mesh;
     const Material * mat;
+    RenderMesh renderMesh;
 
 private:
     BoundingBox bbox;
     Vec3Df trans;
-    Vec3Df origTrans;
     KDtree *tree;
     Vec3Df mobile;
     bool enabled;
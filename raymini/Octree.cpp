@@ -3,12 +3,12 @@
 #include "PointCloud.h"
 #include "Scene.h"
 #include "Surfel.h"
-#include "Controller.h"
+#include "BaseController.h"
 #include "Texture.h"
 
 using namespace std;
 
-Octree::Octree(Controller * c, const PointCloud & cloud) : c(c), cloud(cloud) {
+Octree::Octree(BaseController * c, const PointCloud & cloud) : c(c), cloud(cloud), maxRadius(0.f) {
     bBox = c->getScene()->getBoundingBox();
 
     surfels.resize(cloud.getSurfels().size());
@@ -20,7 +20,11 @@ Octree::Octree(Controller * c, const PointCloud & cloud) : c(c), cloud(cloud) {
 }
 
 void Octree::next() {
-    if(surfels.size() <= MIN_SURFELS) return;//leaf
+    if(surfels.size() <= MIN_SURFELS) {//leaf
+        for(unsigned index_surfel : surfels)
+            maxRadius = max(maxRadius, cloud.getSurfels()[index_surfel].getRadius());
+        return;
+    }
 
     array<BoundingBox, 8> s;
     bBox.subdivide(s);
@@ -32,6 +36,9 @@ void Octree::next() {
 
     for(unsigned int index = 0; index < 8; index++) {
         sons[index] = new Octree(c, cloud, array_surfels[index], s[index]);
+        const float r = sons[index]->maxRadius;
+        maxRadius = max(maxRadius, r);
+        sonBoxes.set(index, BoundingBox(s[index].getMin()-Vec3Df(r, r, r), s[index].getMax()+Vec3Df(r, r, r)));
     }
 }
 
@@ -83,10 +90,6 @@ Surfel Octree::getMeanSurfel() const {
     return Surfel(p/8.0, n, radius/8.0, color/8.0, new Material(c, "Surfel", 1.0f, 0.0f, new SingleColorTexture(color/255.0), normalTexture));
 }
 
-bool Octree::sort_octree(pair<float, bool> p1, pair<float, bool> p2) {
-    return (p1.first < p2.first);
-}
-
 const Octree * Octree::intersect(Ray &ray) const {
 
     if(isLeaf()) {
@@ -101,24 +104,25 @@ const Octree * Octree::intersect(Ray &ray) const {
         return nullptr;
     }
     else {
-        array<pair<float, unsigned int>, 8> pair_intersection;
-        array<Vec3Df, 8> inter_pos;
-        array<bool, 8> is_intersected;
+        float tNear[PackedBoxes::WIDTH];
+        const unsigned hits = ray.getBasicRay().clip(sonBoxes, tNear);
 
+        // Sons crossed by the ray, closest first
+        array<unsigned int, 8> order;
+        unsigned int nbHits = 0;
         for(unsigned int i = 0; i < 8; i++) {
-            pair_intersection[i].second = i;
-            is_intersected[i] = ray.intersect(sons[i]->bBox, inter_pos[i]);
-            pair_intersection[i].first = Vec3Df::squaredDistance (inter_pos[i], ray.getOrigin());
+            if(!(hits & (1u << i)))
+                continue;
+            unsigned int j = nbHits++;
+            for(; j > 0 && tNear[order[j-1]] > tNear[i]; j--)
+                order[j] = order[j-1];
+            order[j] = i;
         }
 
-        sort(pair_intersection.begin(), pair_intersection.end(), Octree::sort_octree);
-
-        for(unsigned int i = 0; i < 8; i++) {
-            const Octree * octree (nullptr);
-            if(is_intersected[pair_intersection[i].second]) {
-                if((octree = sons[pair_intersection[i].second]->intersect(ray)) != nullptr)
-                    return octree;
-            }
+        for(unsigned int i = 0; i < nbHits; i++) {
+            const Octree * octree = sons[order[i]]->intersect(ray);
+            if(octree != nullptr)
+                return octree;
         }
 
         return nullptr;
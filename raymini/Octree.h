@@ -5,23 +5,28 @@
 #include "Vec3D.h"
 #include "BoundingBox.h"
 #include "Ray.h"
+#include "PackedBoxes.h"
 
 class PointCloud;
 class Surfel;
-class Controller;
+class BaseController;
 
 class Octree {
 protected:
-    Controller * c;
+    BaseController * c;
     const PointCloud & cloud;
     std::vector<unsigned> surfels;// sth only if leaf;
     std::array<Octree *, 8> sons;
+    /** Largest radius of the surfels below, their discs may stick out of bBox */
+    float maxRadius;
+    /** Boxes of the sons grown by their maxRadius, tested together by rays */
+    PackedBoxes sonBoxes;
 
 public:
     static const unsigned MIN_SURFELS = 16;
     BoundingBox bBox;
 
-    Octree(Controller * c, const PointCloud &p);
+    Octree(BaseController * c, const PointCloud &p);
 
     ~Octree() {
         for(Octree * & o:sons) {
@@ -34,16 +39,16 @@ public:
     const std::vector<unsigned> &  getSurfels() const { return surfels; }
     bool isLeaf() const {return (sons[0] == nullptr);}
     Surfel getMeanSurfel() const; 
+    /** First leaf holding a disc hit by ray, sons are visited from the closest */
     const Octree * intersect(Ray &ray) const;
-    static bool sort_octree(std::pair<float, bool> p1, std::pair<float, bool> p2);
     
     // useful to draw an Octree
     void exec(void (*f)(const Octree * octree)) const;
 
 private:
-    Octree(Controller * c, const PointCloud & cloud, const std::vector<unsigned> & surfels,
+    Octree(BaseController * c, const PointCloud & cloud, const std::vector<unsigned> & surfels,
            const BoundingBox & b):
-        c(c), cloud(cloud), surfels(surfels),
+        c(c), cloud(cloud), surfels(surfels), maxRadius(0.f),
         bBox(b) {
         for(int i = 0; i < 8; i++)
             sons[i] = nullptr;
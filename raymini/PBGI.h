@@ -6,13 +6,13 @@
 #include "Light.h"
 #include "Observable.h"
 
-class Controller;
+class BaseController;
 
 class PBGI: public Observable {
 public:
     static const unsigned long PBGI_CHANGED = 1<<0;
 
-    PBGI(Controller * c, unsigned int res = 6) : c(c), res(res){
+    PBGI(BaseController * c, unsigned int res = 6) : c(c), res(res){
         cloud = new PointCloud(c);
         cloud->generatePoints();
         octree = new Octree(c, *cloud);
@@ -41,7 +41,7 @@ public:
     }
 
 private:
-    Controller * c;
+    BaseController * c;
     unsigned int res;
     PointCloud * cloud;
     Octree * octree;
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "BoundingBox.h"
+
+/**
+ * Up to WIDTH boxes laid out for the SIMD slab test
+ *
+ * bounds[0] holds the minimums and bounds[1] the maximums, per coordinate
+ * then per lane, so that the near bound of every lane along an axis is
+ * bounds[sign][axis] for the sign of the ray direction.
+ * Unused lanes are inverted boxes that no ray can enter.
+ */
+class PackedBoxes {
+public:
+    static const unsigned WIDTH = 8;
+
+    PackedBoxes() {
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            for (unsigned l = 0 ; l < WIDTH ; l++) {
+                bounds[0][i][l] = 1e30f;
+                bounds[1][i][l] = -1e30f;
+            }
+        }
+    }
+
+    void set(unsigned lane, const BoundingBox & box) {
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            bounds[0][i][lane] = box.getMin()[i];
+            bounds[1][i][lane] = box.getMax()[i];
+        }
+    }
+
+    float bounds[2][3][WIDTH];
+};
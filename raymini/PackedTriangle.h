@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Vec3D.h"
+#include "RenderMesh.h"
+
+/**
+ * Up to WIDTH triangles laid out for the SIMD intersection test
+ *
+ * Each field is stored per coordinate then per lane (structure of arrays).
+ * c is the third vertex, eU = a - c and eV = b - c as in BasicRay::intersect,
+ * n = eU x eV is not normalized.
+ * Unused lanes keep a null normal so no ray can hit them.
+ * The render mesh is only read back through id once a hit is found.
+ */
+class PackedTriangles {
+public:
+    static const unsigned WIDTH = 4;
+
+    PackedTriangles() {
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            for (unsigned l = 0 ; l < WIDTH ; l++) {
+                c[i][l] = eU[i][l] = eV[i][l] = n[i][l] = 0.f;
+            }
+        }
+        for (unsigned l = 0 ; l < WIDTH ; l++) {
+            id[l] = 0;
+        }
+    }
+
+    /** Fill a lane with the triangle id of mesh */
+    void set(unsigned lane, const RenderMesh & mesh, unsigned triangle) {
+        const Vec3Df a = mesh.getPosition(mesh.getVertex(triangle, 0));
+        const Vec3Df b = mesh.getPosition(mesh.getVertex(triangle, 1));
+        const Vec3Df vc = mesh.getPosition(mesh.getVertex(triangle, 2));
+        const Vec3Df vU = a - vc;
+        const Vec3Df vV = b - vc;
+        const Vec3Df vn = Vec3Df::crossProduct(vU, vV);
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            c[i][lane] = vc[i];
+            eU[i][lane] = vU[i];
+            eV[i][lane] = vV[i];
+            n[i][lane] = vn[i];
+        }
+        id[lane] = triangle;
+    }
+
+    float c[3][WIDTH];
+    float eU[3][WIDTH];
+    float eV[3][WIDTH];
+    float n[3][WIDTH];
+    /** Index in the render mesh triangles */
+    unsigned id[WIDTH];
+};
@@ -6,11 +6,11 @@
 #include "Brdf.h"
 #include "Material.h"
 #include "RayTracer.h"
-#include "Controller.h"
+#include "BaseController.h"
 
 using namespace std;
 
-PointCloud::PointCloud(Controller * c): c(c), resolution(256) {}
+PointCloud::PointCloud(BaseController * c): c(c), resolution(256) {}
 
 
 PointCloud::~PointCloud() {
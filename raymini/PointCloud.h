@@ -7,21 +7,21 @@
 #include "Scene.h"
 #include "Light.h"
 
-class Controller;
+class BaseController;
 
 /**
  * A point cloud
  */
 class PointCloud {
 private:
-    Controller * c;
+    BaseController * c;
     std::vector<Surfel> surfels;
     std::vector<Object*> objects;
     float resolution;
 
 public:
     /** Construct point cloud from the scene */
-    PointCloud(Controller * c);
+    PointCloud(BaseController * c);
 
     ~PointCloud();
 
@@ -1,11 +1,11 @@
 #include <iomanip>
 
 #include "ProgressBar.h"
-#include "Controller.h"
+#include "BaseController.h"
 
 using namespace std;
 
-ProgressBar::ProgressBar(Controller *c, unsigned nbIter):
+ProgressBar::ProgressBar(BaseController *c, unsigned nbIter):
     controller(c),
     max(nbIter),
     current(0),
@@ -5,12 +5,12 @@
 #include <omp.h>
 #include <iostream>
 
-class Controller;
+class BaseController;
 
 class ProgressBar: public QObject {
     Q_OBJECT
 private:
-    Controller *controller;
+    BaseController *controller;
     unsigned max;
     unsigned current;
     omp_lock_t lck;
@@ -22,7 +22,7 @@ private:
     void unlock() { omp_unset_lock(&lck); }
 
 public:
-    ProgressBar(Controller *, unsigned nbIter);
+    ProgressBar(BaseController *, unsigned nbIter);
     virtual ~ProgressBar();
 
     void operator()();
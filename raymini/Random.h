@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * PCG32 random number generator (XSH RR output of a 64 bits LCG)
+ *
+ * Every thread has its own generator, see local(), so that sampling never
+ * takes a lock. The renderer seeds it for each pixel sample from the seed
+ * of the frame, which makes pictures independent of thread scheduling.
+ * Meets the UniformRandomBitGenerator requirements, for std::shuffle.
+ */
+class Random {
+public:
+    typedef uint32_t result_type;
+
+    Random(uint64_t s = 0) { seed(s); }
+
+    inline void seed(uint64_t s) {
+        state = 0;
+        next();
+        state += s;
+        next();
+    }
+
+    inline uint32_t next() {
+        const uint64_t old = state;
+        state = old*6364136223846793005ull + INCREMENT;
+        const uint32_t xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+        const uint32_t rotation = uint32_t(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+    }
+
+    /** In [0, 1[ */
+    inline float uniform() { return float(next() >> 8)*(1.f/16777216.f); }
+    /** In [a, b[ */
+    inline float uniform(float a, float b) { return a + uniform()*(b-a); }
+
+    inline uint32_t operator()() { return next(); }
+    static constexpr uint32_t min() { return 0; }
+    static constexpr uint32_t max() { return UINT32_MAX; }
+
+    /** Generator of the calling thread */
+    static inline Random & local() {
+        static thread_local Random random;
+        return random;
+    }
+
+    /** Seed derived from a and b, close values giving unrelated seeds (SplitMix64) */
+    static inline uint64_t hash(uint64_t a, uint64_t b) {
+        uint64_t z = a + (b+1)*0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static const uint64_t INCREMENT = 1442695040888963407ull;
+
+    uint64_t state;
+};
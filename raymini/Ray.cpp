@@ -5,149 +5,312 @@
 // All rights reserved.
 // *********************************************************
 
-#include <GL/glew.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "Ray.h"
+#include "Object.h"
 
 using namespace std;
 
-static const unsigned int NUMDIM = 3, RIGHT = 0, LEFT = 1, MIDDLE = 2;
-
-bool Ray::intersect (const BoundingBox & bbox, Vec3Df & intersectionPoint) const {
-    const Vec3Df & minBb = bbox.getMin ();
-    const Vec3Df & maxBb = bbox.getMax ();
-    bool inside = true;
-    unsigned int  quadrant[NUMDIM];
-    register unsigned int i;
-    unsigned int whichPlane;
-    Vec3Df maxT;
-    Vec3Df candidatePlane;
-
-    for (i=0; i<NUMDIM; i++)
-        if (origin[i] < minBb[i]) {
-            quadrant[i] = LEFT;
-            candidatePlane[i] = minBb[i];
-            inside = false;
-        } else if (origin[i] > maxBb[i]) {
-            quadrant[i] = RIGHT;
-            candidatePlane[i] = maxBb[i];
-            inside = false;
-        } else	{
-            quadrant[i] = MIDDLE;
-        }
+static bool cpuSupportsSSE() {
+#ifdef __SSE2__
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+bool BasicRay::useSIMD = cpuSupportsSSE();
+
+unsigned BasicRay::clip(const PackedBoxes &boxes, float tNear[PackedBoxes::WIDTH]) const {
+#ifdef __SSE2__
+    if (useSIMD) {
+        return clipSSE(boxes, tNear);
+    }
+#endif
+    return clipScalar(boxes, tNear);
+}
 
-    if (inside)	{
-        intersectionPoint = origin;
-        return (true);
+bool BasicRay::intersect(const PackedTriangles &t, Object *o, Hit &hit) const {
+#ifdef __SSE2__
+    if (useSIMD) {
+        return intersectSSE(t, o, hit);
     }
+#endif
+    return intersectScalar(t, o, hit);
+}
+
+bool BasicRay::occluded(const PackedTriangles &t, float tMax) const {
+#ifdef __SSE2__
+    if (useSIMD) {
+        return occludedSSE(t, tMax);
+    }
+#endif
+    return occludedScalar(t, tMax);
+}
 
-    for (i = 0; i < NUMDIM; i++)
-        if (quadrant[i] != MIDDLE && direction[i] !=0.)
-            maxT[i] = (candidatePlane[i]-origin[i]) / direction[i];
-        else
-            maxT[i] = -1.;
-
-    whichPlane = 0;
-    for (i = 1; i < NUMDIM; i++)
-        if (maxT[whichPlane] < maxT[i])
-            whichPlane = i;
-
-    if (maxT[whichPlane] < 0.) return (false);
-    for (i = 0; i < NUMDIM; i++)
-        if (whichPlane != i) {
-            intersectionPoint[i] = origin[i] + maxT[whichPlane] *direction[i];
-            if (intersectionPoint[i] < minBb[i] - BBOX_INTERSEC_DELTA ||
-                intersectionPoint[i] > maxBb[i] + BBOX_INTERSEC_DELTA)
-                return (false);
-        } else {
-            intersectionPoint[i] = candidatePlane[i];
+unsigned BasicRay::clipScalar(const PackedBoxes &boxes, float tNear[PackedBoxes::WIDTH]) const {
+    unsigned mask = 0;
+    for (unsigned l = 0 ; l < PackedBoxes::WIDTH ; l++) {
+        float tMin = 0.f, tMax = 1e30f;
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            const float near = (boxes.bounds[sign[i]][i][l] - origin[i]) * invDirection[i];
+            const float far = (boxes.bounds[1-sign[i]][i][l] - origin[i]) * invDirection[i];
+            tMin = max(tMin, near);
+            tMax = min(tMax, far);
         }
-    return (true);
+        tNear[l] = tMin;
+        mask |= unsigned(tMin <= tMax) << l;
+    }
+    return mask;
 }
 
+bool BasicRay::intersectScalar(const PackedTriangles &t, Object *o, Hit &hit) const {
+    bool found = false;
+    for (unsigned l = 0 ; l < PackedTriangles::WIDTH ; l++) {
+        const Vec3Df vc(t.c[0][l], t.c[1][l], t.c[2][l]);
+        const Vec3Df vU(t.eU[0][l], t.eU[1][l], t.eU[2][l]);
+        const Vec3Df vV(t.eV[0][l], t.eV[1][l], t.eV[2][l]);
+        const Vec3Df nn(t.n[0][l], t.n[1][l], t.n[2][l]);
+        float norm = Vec3Df::dotProduct(nn, direction);
 
-bool Ray::intersect(const Triangle &t, const Vertex & v1, const Vertex & v2, const Vertex & v3, Object *o) {
-    Vec3Df vecU = v1.getPos() - v3.getPos();
-    Vec3Df vecV = v2.getPos() - v3.getPos();
-    Vec3Df nn = Vec3Df::crossProduct(vecU, vecV);
-    Vec3Df Otr = origin - v3.getPos();
-    float norm = Vec3Df::dotProduct(nn, direction);
+        // If triangle turned (or empty lane)
+        if (!(norm < 0)) {
+            continue;
+        }
 
-    // If triangle turned
-    if (norm > 0) {
-        return false;
+        Vec3Df Otr = origin - vc;
+
+        // If starting ray behind triangle
+        if (Vec3Df::dotProduct(nn, Otr) < 0) {
+            continue;
+        }
+
+        // Coordinates into triangle
+        float Iu = Vec3Df::dotProduct(Vec3Df::crossProduct(Otr, vV), direction)/norm;
+
+        if ( (0>Iu) || (Iu>1) ) {
+            continue;
+        }
+
+        float Iv = Vec3Df::dotProduct(Vec3Df::crossProduct(vU, Otr), direction)/norm;
+
+        if ( (0>Iv) || (Iv>1) || (Iu+Iv>1) ) {
+            continue;
+        }
+
+        Vec3Df pos = vc + Iu*vU + Iv*vV;
+        float distance = Vec3Df::squaredDistance (pos, origin);
+        found = true;
+
+        if (distance < hit.distance) {
+            hit.object = o;
+            hit.triangle = t.id[l];
+            hit.distance = distance;
+            hit.u = Iu;
+            hit.v = Iv;
+        }
     }
+    return found;
+}
 
-    // If starting ray behind triangle
-    if (Vec3Df::dotProduct(nn, Otr) < 0) {
-        return false;
+bool BasicRay::occludedScalar(const PackedTriangles &t, float tMax) const {
+    for (unsigned l = 0 ; l < PackedTriangles::WIDTH ; l++) {
+        const Vec3Df vc(t.c[0][l], t.c[1][l], t.c[2][l]);
+        const Vec3Df vU(t.eU[0][l], t.eU[1][l], t.eU[2][l]);
+        const Vec3Df vV(t.eV[0][l], t.eV[1][l], t.eV[2][l]);
+        const Vec3Df nn(t.n[0][l], t.n[1][l], t.n[2][l]);
+        float norm = Vec3Df::dotProduct(nn, direction);
+        if (!(norm < 0)) {
+            continue;
+        }
+
+        // Distance along the ray, t = side / -norm
+        Vec3Df Otr = origin - vc;
+        float side = Vec3Df::dotProduct(nn, Otr);
+        if (side < 0 || side >= -norm*tMax) {
+            continue;
+        }
+
+        float Iu = Vec3Df::dotProduct(Vec3Df::crossProduct(Otr, vV), direction)/norm;
+        float Iv = Vec3Df::dotProduct(Vec3Df::crossProduct(vU, Otr), direction)/norm;
+        if (Iu >= 0 && Iv >= 0 && Iu+Iv <= 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef __SSE2__
+unsigned BasicRay::clipSSE(const PackedBoxes &boxes, float tNear[PackedBoxes::WIDTH]) const {
+    unsigned mask = 0;
+    for (unsigned g = 0 ; g < PackedBoxes::WIDTH ; g += 4) {
+        __m128 tMin = _mm_setzero_ps();
+        __m128 tMax = _mm_set1_ps(1e30f);
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            const __m128 o = _mm_set1_ps(origin[i]);
+            const __m128 inv = _mm_set1_ps(invDirection[i]);
+            const __m128 near = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.bounds[sign[i]][i]+g), o), inv);
+            const __m128 far = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(boxes.bounds[1-sign[i]][i]+g), o), inv);
+            // Second operand is kept when the first is NaN
+            tMin = _mm_max_ps(near, tMin);
+            tMax = _mm_min_ps(far, tMax);
+        }
+        _mm_storeu_ps(tNear+g, tMin);
+        mask |= unsigned(_mm_movemask_ps(_mm_cmple_ps(tMin, tMax))) << g;
     }
+    return mask;
+}
 
-    // Coordinates into triangle
-    float Iu = Vec3Df::dotProduct(Vec3Df::crossProduct(Otr, vecV), direction)/norm;
+bool BasicRay::occludedSSE(const PackedTriangles &t, float tMax) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 dx = _mm_set1_ps(direction[0]);
+    const __m128 dy = _mm_set1_ps(direction[1]);
+    const __m128 dz = _mm_set1_ps(direction[2]);
 
-    if ( (0>Iu) || (Iu>1) ) {
+    const __m128 nx = _mm_loadu_ps(t.n[0]);
+    const __m128 ny = _mm_loadu_ps(t.n[1]);
+    const __m128 nz = _mm_loadu_ps(t.n[2]);
+    const __m128 norm = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz));
+    __m128 mask = _mm_cmplt_ps(norm, zero);
+    if (!_mm_movemask_ps(mask)) {
         return false;
     }
 
-    float Iv = Vec3Df::dotProduct(Vec3Df::crossProduct(vecU, Otr), direction)/norm;
+    const __m128 ox = _mm_sub_ps(_mm_set1_ps(origin[0]), _mm_loadu_ps(t.c[0]));
+    const __m128 oy = _mm_sub_ps(_mm_set1_ps(origin[1]), _mm_loadu_ps(t.c[1]));
+    const __m128 oz = _mm_sub_ps(_mm_set1_ps(origin[2]), _mm_loadu_ps(t.c[2]));
 
-    if ( (0>Iv) || (Iv>1) || (Iu+Iv>1) ) {
+    // 0 <= t < tMax with t = side / -norm
+    const __m128 side = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ox), _mm_mul_ps(ny, oy)), _mm_mul_ps(nz, oz));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(side, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(side, _mm_mul_ps(_mm_sub_ps(zero, norm), _mm_set1_ps(tMax))));
+    if (!_mm_movemask_ps(mask)) {
         return false;
     }
 
-    Vec3Df pos = v3.getPos() + Iu*vecU + Iv*vecV;
-    float distance = Vec3Df::squaredDistance (pos, origin);
-
-    if (!hasIntersection || distance < intersectionDistance) {
-        hasIntersection = true;
-        intersectionDistance = distance;
-        intersection = pos;
-        a = &v1; b = &v2 ; c = &v3;
-        u = Iu;
-        v = Iv;
-        intersectedObject = o;
-        this->t = &t;
-    }
+    const __m128 ux = _mm_loadu_ps(t.eU[0]);
+    const __m128 uy = _mm_loadu_ps(t.eU[1]);
+    const __m128 uz = _mm_loadu_ps(t.eU[2]);
+    const __m128 vx = _mm_loadu_ps(t.eV[0]);
+    const __m128 vy = _mm_loadu_ps(t.eV[1]);
+    const __m128 vz = _mm_loadu_ps(t.eV[2]);
 
-    return true;
+    // Barycentrics scaled by norm (negative): compare signs without dividing
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(oy, vz), _mm_mul_ps(oz, vy));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(oz, vx), _mm_mul_ps(ox, vz));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(ox, vy), _mm_mul_ps(oy, vx));
+    const __m128 su = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, dx), _mm_mul_ps(qy, dy)), _mm_mul_ps(qz, dz));
+    const __m128 rx = _mm_sub_ps(_mm_mul_ps(uy, oz), _mm_mul_ps(uz, oy));
+    const __m128 ry = _mm_sub_ps(_mm_mul_ps(uz, ox), _mm_mul_ps(ux, oz));
+    const __m128 rz = _mm_sub_ps(_mm_mul_ps(ux, oy), _mm_mul_ps(uy, ox));
+    const __m128 sv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, dx), _mm_mul_ps(ry, dy)), _mm_mul_ps(rz, dz));
+
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmple_ps(su, zero), _mm_cmple_ps(sv, zero)));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(su, sv), norm));
+    return _mm_movemask_ps(mask) != 0;
 }
 
-Vec3Df Ray::computeNormal() const {
-    if(!hasIntersection) return Vec3Df();
+bool BasicRay::intersectSSE(const PackedTriangles &t, Object *o, Hit &hit) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 dx = _mm_set1_ps(direction[0]);
+    const __m128 dy = _mm_set1_ps(direction[1]);
+    const __m128 dz = _mm_set1_ps(direction[2]);
 
-    float surf_c = Vec3Df::getSurface(a->getPos(), b->getPos(), intersection);
-    float surf_b = Vec3Df::getSurface(a->getPos(), c->getPos(), intersection);
-    float surf_a = Vec3Df::getSurface(c->getPos(), b->getPos(), intersection);
+    const __m128 nx = _mm_loadu_ps(t.n[0]);
+    const __m128 ny = _mm_loadu_ps(t.n[1]);
+    const __m128 nz = _mm_loadu_ps(t.n[2]);
+    const __m128 norm = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz));
+    // Front facing and non empty lanes
+    __m128 mask = _mm_cmplt_ps(norm, zero);
+    if (!_mm_movemask_ps(mask)) {
+        return false;
+    }
+
+    const __m128 cx = _mm_loadu_ps(t.c[0]);
+    const __m128 cy = _mm_loadu_ps(t.c[1]);
+    const __m128 cz = _mm_loadu_ps(t.c[2]);
+    const __m128 ox = _mm_sub_ps(_mm_set1_ps(origin[0]), cx);
+    const __m128 oy = _mm_sub_ps(_mm_set1_ps(origin[1]), cy);
+    const __m128 oz = _mm_sub_ps(_mm_set1_ps(origin[2]), cz);
+
+    // Starting ray in front of triangle
+    const __m128 side = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ox), _mm_mul_ps(ny, oy)), _mm_mul_ps(nz, oz));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(side, zero));
+
+    const __m128 ux = _mm_loadu_ps(t.eU[0]);
+    const __m128 uy = _mm_loadu_ps(t.eU[1]);
+    const __m128 uz = _mm_loadu_ps(t.eU[2]);
+    const __m128 vx = _mm_loadu_ps(t.eV[0]);
+    const __m128 vy = _mm_loadu_ps(t.eV[1]);
+    const __m128 vz = _mm_loadu_ps(t.eV[2]);
+    const __m128 invNorm = _mm_div_ps(one, norm);
 
-    Vec3Df normal =
-        surf_a*a->getNormal() +
-        surf_b*b->getNormal() +
-        surf_c*c->getNormal();
+    // Iu = ((Otr x eV) . dir) / norm
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(oy, vz), _mm_mul_ps(oz, vy));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(oz, vx), _mm_mul_ps(ox, vz));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(ox, vy), _mm_mul_ps(oy, vx));
+    const __m128 Iu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, dx), _mm_mul_ps(qy, dy)), _mm_mul_ps(qz, dz)), invNorm);
 
-    normal.normalize();
+    // Iv = ((eU x Otr) . dir) / norm
+    const __m128 rx = _mm_sub_ps(_mm_mul_ps(uy, oz), _mm_mul_ps(uz, oy));
+    const __m128 ry = _mm_sub_ps(_mm_mul_ps(uz, ox), _mm_mul_ps(ux, oz));
+    const __m128 rz = _mm_sub_ps(_mm_mul_ps(ux, oy), _mm_mul_ps(uy, ox));
+    const __m128 Iv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, dx), _mm_mul_ps(ry, dy)), _mm_mul_ps(rz, dz)), invNorm);
+
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(Iu, zero), _mm_cmpge_ps(Iv, zero)));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(Iu, Iv), one));
+    const int hits = _mm_movemask_ps(mask);
+    if (!hits) {
+        return false;
+    }
 
-    return normal;
+    // pos - origin = eU Iu + eV Iv - Otr
+    const __m128 px = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ux, Iu), _mm_mul_ps(vx, Iv)), ox);
+    const __m128 py = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(uy, Iu), _mm_mul_ps(vy, Iv)), oy);
+    const __m128 pz = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(uz, Iu), _mm_mul_ps(vz, Iv)), oz);
+    const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz));
+
+    float d[4], su[4], sv[4];
+    _mm_storeu_ps(d, distance);
+    _mm_storeu_ps(su, Iu);
+    _mm_storeu_ps(sv, Iv);
+
+    for (unsigned l = 0 ; l < PackedTriangles::WIDTH ; l++) {
+        if ((hits & (1 << l)) && d[l] < hit.distance) {
+            hit.object = o;
+            hit.triangle = t.id[l];
+            hit.distance = d[l];
+            hit.u = su[l];
+            hit.v = sv[l];
+        }
+    }
+    return true;
 }
+#endif
+
+Vertex Ray::computeIntersection() const {
+    if(!hit.object) return Vertex();
 
-void Ray::draw(float r, float g, float b) {
-    glColor3f(r, g, b);
-    glBegin(GL_LINES);
-    glVertex3f(origin[0], origin[1], origin[2]);
-    glVertex3f(origin[0]+direction[0], origin[1]+direction[1], origin[2]+direction[2]);
-    glEnd();
+    const RenderMesh & mesh = hit.object->getRenderMesh();
+    return {mesh.interpolatePosition(hit.triangle, hit.u, hit.v)+trans,
+            mesh.interpolateNormal(hit.triangle, hit.u, hit.v)};
 }
 
 bool Ray::intersectDisc(const Vec3Df & center, const Vec3Df & normal, float radius) {
+    const Vec3Df & origin = ray.origin;
+    const Vec3Df & direction = ray.direction;
     float d = -Vec3Df::dotProduct(center, normal);
     float t = -(Vec3Df::dotProduct(origin, normal) + d) / Vec3Df::dotProduct(direction, normal);
     Vec3Df posIntersection = origin + t*direction;
 
 
     if((t > 0.0) && (center - posIntersection).getSquaredLength() < radius*radius) {
-        hasIntersection = true;
-        intersectionDistance = (posIntersection - origin).getLength();
-        intersection = posIntersection;
+        hit = Hit();
+        hit.distance = (posIntersection - origin).getLength();
         return true;
     }
     return false;
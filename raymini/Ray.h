@@ -15,74 +15,173 @@
 #include "BoundingBox.h"
 #include "Vertex.h"
 #include "Triangle.h"
+#include "PackedTriangle.h"
+#include "PackedBoxes.h"
 
 class Object;
 
+/**
+ * Closest hit found so far along a ray
+ *
+ * Only what traversals need to compare and update hits is kept, shading
+ * data (position, normal, texture coordinates) is rebuilt from it once
+ * the closest hit is known.
+ */
+class Hit {
+public:
+    /** Distance of rays that hit nothing, farther than any hit */
+    static constexpr float NONE = 1e30f;
+
+    inline Hit () : object(nullptr), triangle(0), distance(NONE), u(0.f), v(0.f) {}
+
+    inline bool found() const { return distance < NONE; }
+
+    Object *object;
+    /** Index of the hit triangle in the render mesh of object */
+    unsigned triangle;
+    /** Squared distance from the ray origin */
+    float distance;
+    /** Coordinate in ca */
+    float u;
+    /** Coordinate in cb */
+    float v;
+};
+
+/**
+ * Origin and direction with the inverse direction and its signs, computed
+ * once per ray for the box and split plane tests of traversals
+ */
+class BasicRay {
+public:
+    inline BasicRay () : time(0.f) {}
+    inline BasicRay (const Vec3Df & origin, const Vec3Df & direction, float time = 0.f)
+        : origin(origin), direction(direction),
+          invDirection(1.f/direction[0], 1.f/direction[1], 1.f/direction[2]), time(time) {
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            sign[i] = invDirection[i] < 0;
+        }
+    }
+
+    /** Same ray moved by offset, as seen from an object translated by -offset */
+    inline BasicRay translated (const Vec3Df & offset) const {
+        BasicRay ray(*this);
+        ray.origin += offset;
+        return ray;
+    }
+
+    /**
+     * Branchless slab test, clips [tMin, tMax] to the part of the ray inside
+     * box, false if nothing is left
+     */
+    inline bool clip (const BoundingBox & box, float & tMin, float & tMax) const {
+        const Vec3Df * bounds[2] = {&box.getMin(), &box.getMax()};
+        for (unsigned i = 0 ; i < 3 ; i++) {
+            const float tNear = ((*bounds[sign[i]])[i] - origin[i]) * invDirection[i];
+            const float tFar = ((*bounds[1-sign[i]])[i] - origin[i]) * invDirection[i];
+            // NaN (ray along a face) leaves the interval as it is
+            tMin = std::max(tMin, tNear);
+            tMax = std::min(tMax, tFar);
+        }
+        return tMin <= tMax;
+    }
+
+    /**
+     * Slab test of WIDTH boxes at once for t >= 0, tNear gets where the ray
+     * enters each box, returns the mask of the boxes it crosses
+     */
+    unsigned clip (const PackedBoxes & boxes, float tNear[PackedBoxes::WIDTH]) const;
+
+    /** Test WIDTH precomputed triangles of o at once, keeps the closest in hit */
+    bool intersect (const PackedTriangles &t, Object *o, Hit &hit) const;
+
+    /**
+     * True if one of the WIDTH triangles is hit at origin + t * direction
+     * with 0 <= t < tMax
+     */
+    bool occluded (const PackedTriangles &t, float tMax) const;
+
+    /** Use SIMD kernels, set by default if the CPU supports them */
+    static bool useSIMD;
+
+    Vec3Df origin;
+    Vec3Df direction;
+    Vec3Df invDirection;
+    /** 1 where direction is negative, -0 included */
+    unsigned sign[3];
+    /** In [0, 1[, places mobile objects along their motion (see Object::getTrans) */
+    float time;
+
+private:
+    unsigned clipScalar (const PackedBoxes & boxes, float tNear[PackedBoxes::WIDTH]) const;
+    unsigned clipSSE (const PackedBoxes & boxes, float tNear[PackedBoxes::WIDTH]) const;
+    bool intersectScalar (const PackedTriangles &t, Object *o, Hit &hit) const;
+    bool intersectSSE (const PackedTriangles &t, Object *o, Hit &hit) const;
+    bool occludedScalar (const PackedTriangles &t, float tMax) const;
+    bool occludedSSE (const PackedTriangles &t, float tMax) const;
+};
+
+/**
+ * Ray with its closest hit, as given to shading
+ * Traversals work on the BasicRay and the Hit, the intersection vertex is
+ * only computed when asked for.
+ */
 class Ray {
 public:
-    inline Ray () : hasIntersection(false) , intersectionDistance(1000000.f){}
-    inline Ray (const Vec3Df & origin, const Vec3Df & direction)
-        : origin (origin), direction (direction),
-          hasIntersection(false) , intersectionDistance(1000000.f),
-          isComputed(false) {}
-    inline virtual ~Ray () {}
-
-    inline const Vec3Df & getOrigin () const { return origin; }
-    inline Vec3Df & getOrigin () { return origin; }
-    inline const Vec3Df & getDirection () const { return direction; }
-    inline Vec3Df & getDirection () { return direction; }
+    inline Ray () : isComputed(false) {}
+    /** time in [0, 1[ places mobile objects along their motion (see Object::getTrans) */
+    inline Ray (const Vec3Df & origin, const Vec3Df & direction, float time = 0.f)
+        : ray(origin, direction, time), isComputed(false) {}
+
+    inline const BasicRay & getBasicRay () const { return ray; }
+    inline const Vec3Df & getOrigin () const { return ray.origin; }
+    inline Vec3Df & getOrigin () { return ray.origin; }
+    inline const Vec3Df & getDirection () const { return ray.direction; }
+    inline float getTime () const { return ray.time; }
+
+    inline const Hit & getHit () const { return hit; }
+    inline Hit & getHit () { return hit; }
+
     inline Vertex getIntersection() {
         if(!isComputed) {
-            computedIntersection = {intersection+trans, computeNormal()};
+            computedIntersection = computeIntersection();
             isComputed = true;
         }
         return computedIntersection;
     }
-    inline float getIntersectionDistance() const { return intersectionDistance; }
-    inline bool intersect() const { return hasIntersection; }
+    inline float getIntersectionDistance() const { return hit.distance; }
+    inline bool intersect() const { return hit.found(); }
 
     void translate(const Vec3Df & trans) {
         this->trans = trans;
     }
 
-    bool intersect (const BoundingBox & bbox, Vec3Df & intersectionPoint) const;
-    bool intersect (const Triangle &t, const Vertex & v1, const Vertex & v2, const Vertex & v3, Object *o);
+    /** Test WIDTH precomputed triangles of o at once, keeps the closest */
+    inline bool intersect (const PackedTriangles &t, Object *o) { return ray.intersect(t, o, hit); }
+
+    /** Hit with a distance that is not squared and no object, see Octree */
     bool intersectDisc(const Vec3Df & center, const Vec3Df & normal, float radius) ;
 
-    /** Debug ray drawing using OpenGL */
+    /** Debug ray drawing using OpenGL, only available in the GUI, see GLDrawing.cpp */
     void draw(float r = 1.0, float g = 1.0, float b = 1.0);
 
-    inline const Vertex *getA() const {return a;}
-    inline const Vertex *getB() const {return b;}
-    inline const Vertex *getC() const {return c;}
-
     /** Coordinate in ca */
-    inline float getU() const {return u;}
+    inline float getU() const {return hit.u;}
     /** Coordinate in cb */
-    inline float getV() const {return v;}
+    inline float getV() const {return hit.v;}
 
-    const Triangle *getTriangle() const {return t;}
+    /** Index of the hit triangle in the render mesh of the intersected object */
+    unsigned getTriangle() const {return hit.triangle;}
 
-    Object *getIntersectedObject() const {return intersectedObject;}
+    Object *getIntersectedObject() const {return hit.object;}
 
 private:
-    static constexpr float BBOX_INTERSEC_DELTA = 0.1f;
-    Vec3Df origin;
-    Vec3Df direction;
-
-    bool hasIntersection;
-    Vec3Df intersection;
-    float intersectionDistance;
+    BasicRay ray;
+    Hit hit;
 
+    Vec3Df trans;
     bool isComputed;
     Vertex computedIntersection;
-    Vec3Df trans;
-    const Vertex *a, *b, *c;
-    const Triangle *t;
-    Vec3Df computeNormal() const;
-    float u;
-    float v;
-    Object *intersectedObject;
+    Vertex computeIntersection() const;
 };
 
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Ray.h"
+
+/**
+ * Up to SIZE rays traced together, typically a TILE x TILE block of camera rays
+ * Only rays whose bit is set in mask are traced, each one keeps its own hit
+ */
+class RayPacket {
+public:
+    static const unsigned TILE = 4;
+    static const unsigned SIZE = TILE*TILE;
+
+    RayPacket(): mask(0) {}
+
+    Ray rays[SIZE];
+    unsigned mask;
+
+    inline bool isActive(unsigned i) const { return mask & (1u << i); }
+    inline void set(unsigned i, const Ray & ray) {
+        rays[i] = ray;
+        mask |= 1u << i;
+    }
+
+    /**
+     * True if every active ray goes towards the same octant, with no null
+     * direction component: only such packets can traverse trees together
+     */
+    inline bool isCoherent() const {
+        int sign[3] = {0, 0, 0};
+        for (unsigned i = 0 ; i < SIZE ; i++) {
+            if (!isActive(i)) {
+                continue;
+            }
+            for (unsigned a = 0 ; a < 3 ; a++) {
+                const float d = rays[i].getDirection()[a];
+                const int s = d > 0 ? 1 : (d < 0 ? -1 : 0);
+                if (s == 0 || (sign[a] && s != sign[a])) {
+                    return false;
+                }
+                sign[a] = s;
+            }
+        }
+        return true;
+    }
+};
@@ -8,12 +8,17 @@
 #include <QImage>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <omp.h>
 
-#include "Controller.h"
+#include "BaseController.h"
 #include "ProgressBar.h"
 #include "RayTracer.h"
 #include "Ray.h"
+#include "RayPacket.h"
+#include "TileScheduler.h"
 #include "Scene.h"
+#include "PBGI.h"
 #include "Color.h"
 #include "Brdf.h"
 
@@ -24,10 +29,11 @@ inline int clamp (float f) {
     return min(max(v, 0), 255);
 }
 
-RayTracer::RayTracer(Controller *c):
+RayTracer::RayTracer(BaseController *c):
     mode(Mode::PATH_TRACING_MODE),
     depthPathTracing(0), nbRayPathTracing(50),
-    intensityPathTracing(6.0f), onlyPathTracing(false),
+    intensityPathTracing(1.0f), onlyPathTracing(false),
+    intensityPBGI(6.0f),
     radiusAmbientOcclusion(2), nbRayAmbientOcclusion(0), maxAngleAmbientOcclusion(M_PI/3),
     intensityAmbientOcclusion(1/5.f), onlyAmbientOcclusion(false),
     typeAntiAliasing(AntiAliasing::NONE), nbRayAntiAliasing(4),
@@ -39,8 +45,21 @@ RayTracer::RayTracer(Controller *c):
     durtiestQuality(ONE_OVER_X),
     backgroundColor(Vec3Df(.1f, .1f, .3f)),
     shadow(this),
-    controller(c)
-{}
+    progressive(false),
+    adaptiveError(0.f),
+    seed(0),
+    samplerType(Sampler::SOBOL),
+    controller(c),
+    nbRayCounts(max(omp_get_max_threads(), 1)),
+    rayCountsStorage(new char[(nbRayCounts+1)*sizeof(RayCounts)])
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>(rayCountsStorage.get());
+    char *first = rayCountsStorage.get() + (alignof(RayCounts) - address%alignof(RayCounts))%alignof(RayCounts);
+    rayCounts = reinterpret_cast<RayCounts *>(first);
+    for (unsigned t = 0; t < nbRayCounts; t++) {
+        new (rayCounts + t) RayCounts();
+    }
+}
 
 QImage RayTracer::RayTracer::render (const Vec3Df & camPos,
                                      const Vec3Df & direction,
@@ -49,26 +68,35 @@ QImage RayTracer::RayTracer::render (const Vec3Df & camPos,
                                      float fieldOfView,
                                      float aspectRatio,
                                      unsigned int screenWidth,
-                                     unsigned int screenHeight) const {
+                                     unsigned int screenHeight,
+                                     vector<TileScheduler::Tile> *tiles) const {
     const Scene *scene = controller->getScene();
+    for (unsigned t = 0; t < nbRayCounts; t++) {
+        rayCounts[t] = RayCounts();
+    }
     int qualityDivider = quality==ONE_OVER_X?this->qualityDivider:1;
     // To avoid black pixels on the top of the screen
     unsigned int computedScreenWidth = ceil((float)screenWidth/(float)qualityDivider);
     unsigned int computedScreenHeight = ceil((float)screenHeight/(float)qualityDivider);
- 
-    static vector<Color> buffer;
-    buffer.resize(computedScreenHeight*computedScreenWidth);
 
-    bool raf_PT = quality == OPTIMAL && depthPathTracing && controller->getWindowModel()->isRealTime();
-
-    if(!raf_PT)
-        buffer.clear();
+    // Real time path tracing refines the picture progressively
+    const bool accumulate = quality == OPTIMAL &&
+        (progressive || (depthPathTracing && controller->isRealTime()));
+    const View view = {camPos, direction, upVector, fieldOfView, aspectRatio};
+    if (!accumulate || view != filmView ||
+        film.getWidth() != computedScreenWidth || film.getHeight() != computedScreenHeight) {
+        film.reset(computedScreenWidth, computedScreenHeight);
+        filmView = view;
+    }
+    // Offsets and times shared by the pixels of the frame
+    Sampler::local().start(samplerType, Random::hash(seed, ~0ull), film.getMinNbSamples(),
+                           Sampler::PIXEL_DIMENSION);
 
     vector<pair<float, float>> singleNulOffset;
     singleNulOffset.push_back(pair<float, float>(0, 0));
 
     int nbRay = max(nbRayAntiAliasing, (depthPathTracing) ? nbRayPathTracing : 0);
-    nbRay = (raf_PT) ? 1 : nbRay;
+    nbRay = (accumulate) ? 1 : nbRay;
     const vector<pair<float, float>> offsets =  (quality==OPTIMAL) ?
                                                 AntiAliasing::generateOffsets(typeAntiAliasing, nbRay) : singleNulOffset;
     const vector<pair<float, float>> offsets_focus = Focus::generateOffsets(typeFocus, apertureFocus, nbRayFocus);
@@ -77,30 +105,101 @@ QImage RayTracer::RayTracer::render (const Vec3Df & camPos,
     const Vec3Df rightVec = tang * aspectRatio * rightVector / computedScreenWidth;
     const Vec3Df upVec = tang * upVector / computedScreenHeight;
 
-    const Vec3Df camToObject = controller->getWindowModel()->getFocusPoint().getPos() - camPos;
+    const Vec3Df camToObject = controller->getFocusPoint().getPos() - camPos;
     const float focalDistance = Vec3Df::dotProduct(camToObject, direction) - distanceOrthogonalCameraScreen;
 
-    const unsigned nbIterations = scene->hasMobile()&&quality==OPTIMAL?nbPictures:1;
-    ProgressBar progressBar(controller, nbIterations*computedScreenWidth);
-
-    // For each picture
-    for (unsigned picNumber = 0 ; picNumber < nbIterations; picNumber++) {
-
-        // For each pixel
-        #pragma omp parallel for
-        for (unsigned int i = 0; i < computedScreenWidth; i++) {
-            progressBar();
-            for (unsigned int j = 0; j < computedScreenHeight && !controller->getRenderThread()->isEmergencyStop(); j++) {
-                buffer[j*computedScreenWidth+i] += computePixel(camPos,
-                                                                direction,
-                                                                upVec, rightVec,
-                                                                computedScreenWidth, computedScreenHeight,
-                                                                offsets, offsets_focus,
-                                                                focalDistance,
-                                                                i, j);
+    // Motion blur: every sample of a pixel sees mobile objects at its own time
+    const unsigned nbTimes = scene->hasMobile()&&quality==OPTIMAL?nbPictures:1;
+    vector<pair<float, float>> sampleOffsets = offsets;
+    for (unsigned s = offsets.size(); s < nbTimes; s++) {
+        sampleOffsets.push_back(offsets[s%offsets.size()]);
+    }
+    vector<float> times(sampleOffsets.size(), 0.f);
+    if (nbTimes > 1) {
+        // Stratified times, shuffled so that they do not follow the offsets
+        for (unsigned s = 0; s < times.size(); s++) {
+            times[s] = float(s)/float(times.size());
+        }
+        shuffle(times.begin(), times.end(), Random::local());
+    }
+
+    // Adaptive sampling: one sample per pass, and once every pixel got
+    // ADAPTIVE_MIN_SAMPLES of them, only noisy pixels get more
+    const bool adaptive = adaptiveError > 0 && quality == OPTIMAL && !accumulate &&
+        sampleOffsets.size() > ADAPTIVE_MIN_SAMPLES;
+    if (adaptive) {
+        // So that the first samples of regular patterns cover the whole pixel
+        shuffle(sampleOffsets.begin(), sampleOffsets.end(), Random::local());
+    }
+    const unsigned nbPasses = adaptive ? sampleOffsets.size() : 1;
+
+    const unsigned tile = RayPacket::TILE;
+    TileScheduler scheduler(computedScreenWidth, computedScreenHeight, omp_get_max_threads());
+    const unsigned nbTiles = scheduler.getTiles().size();
+    ProgressBar progressBar(controller, nbTiles*nbPasses);
+
+    // Pixels computed by the pass, all of them if empty
+    vector<unsigned char> active;
+    unsigned pass = 0;
+    for (; pass < nbPasses && !controller->isEmergencyStop(); pass++) {
+        const vector<pair<float, float>> passOffsets = adaptive ?
+            vector<pair<float, float>>(1, sampleOffsets[pass]) : sampleOffsets;
+        const vector<float> passTimes = adaptive ? vector<float>(1, times[pass]) : times;
+        if (pass >= ADAPTIVE_MIN_SAMPLES && !selectNoisyPixels(active)) {
+            break;
+        }
+        if (pass) {
+            scheduler.reset();
+        }
+
+        // For each tile
+        #pragma omp parallel
+        {
+            TileScheduler::Tile t;
+            while (!controller->isEmergencyStop() &&
+                   scheduler.next(omp_get_thread_num(), t)) {
+                auto start = chrono::steady_clock::now();
+
+                // For each packet of the tile
+                for (unsigned int pj = t.y; pj < t.y+t.height; pj += tile) {
+                    for (unsigned int pi = t.x; pi < t.x+t.width; pi += tile) {
+                        unsigned mask = 0;
+                        for (unsigned int k = 0; k < RayPacket::SIZE; k++) {
+                            unsigned int i = pi + k%tile;
+                            unsigned int j = pj + k/tile;
+                            if (i < computedScreenWidth && j < computedScreenHeight &&
+                                (active.empty() || active[j*computedScreenWidth+i])) {
+                                mask |= 1u << k;
+                            }
+                        }
+                        if (!mask) {
+                            continue;
+                        }
+                        Vec3Df colors[RayPacket::SIZE];
+                        computeTile(camPos,
+                                    direction,
+                                    upVec, rightVec,
+                                    computedScreenWidth, computedScreenHeight,
+                                    passOffsets, passTimes, offsets_focus,
+                                    focalDistance,
+                                    pi, pj, mask,
+                                    colors);
+                        for (unsigned int k = 0; k < RayPacket::SIZE; k++) {
+                            if (mask & (1u << k)) {
+                                film.add(pi + k%tile, pj + k/tile, colors[k]);
+                            }
+                        }
+                    }
+                }
+
+                scheduler.addTime(t, chrono::duration<float, milli>(chrono::steady_clock::now()-start).count());
+                progressBar();
             }
         }
-        controller->setSceneMove(nbPictures);
+    }
+    // Passes saved by adaptive sampling are done
+    for (unsigned t = pass*nbTiles; t < nbPasses*nbTiles && !controller->isEmergencyStop(); t++) {
+        progressBar();
     }
 
     QImage image (QSize (screenWidth, screenHeight), QImage::Format_RGB888);
@@ -108,13 +207,63 @@ QImage RayTracer::RayTracer::render (const Vec3Df & camPos,
         unsigned int computedI = i/qualityDivider;
         for (unsigned int j = 0; j < screenHeight; j++) {
             unsigned int computedJ = j/qualityDivider;
-            Color c = buffer[computedJ*computedScreenWidth+computedI];
+            const Vec3Df & c = film.getMean(computedI, computedJ);
             image.setPixel(i, j, qRgb(clamp(c[0]), clamp(c[1]), clamp(c[2])));
         }
     }
 
-    controller->setSceneReset();
+    if (tiles) {
+        *tiles = scheduler.getTiles();
+    }
+
+    return image;
+}
+
+bool RayTracer::selectNoisyPixels(vector<unsigned char> &active) const {
+    const unsigned width = film.getWidth(), height = film.getHeight();
+    vector<unsigned char> noisy(width*height);
+    #pragma omp parallel for
+    for (unsigned j = 0; j < height; j++) {
+        for (unsigned i = 0; i < width; i++) {
+            noisy[j*width+i] = film.getError(i, j) > adaptiveError;
+        }
+    }
+
+    // Neighbors too: few samples can all miss an edge crossing a pixel
+    active.assign(width*height, 0);
+    bool found = false;
+    #pragma omp parallel for reduction(||:found)
+    for (unsigned j = 0; j < height; j++) {
+        for (unsigned i = 0; i < width; i++) {
+            for (unsigned y = j ? j-1 : j; y <= j+1 && y < height && !active[j*width+i]; y++) {
+                for (unsigned x = i ? i-1 : i; x <= i+1 && x < width; x++) {
+                    if (noisy[y*width+x]) {
+                        active[j*width+i] = 1;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return found;
+}
 
+QImage RayTracer::getSampleDensity() const {
+    const unsigned width = film.getWidth(), height = film.getHeight();
+    unsigned maxSamples = 1;
+    for (unsigned j = 0; j < height; j++) {
+        for (unsigned i = 0; i < width; i++) {
+            maxSamples = max(maxSamples, film.getNbSamples(i, j));
+        }
+    }
+    QImage image (QSize (width, height), QImage::Format_RGB888);
+    for (unsigned j = 0; j < height; j++) {
+        for (unsigned i = 0; i < width; i++) {
+            const int gray = clamp(float(film.getNbSamples(i, j))/float(maxSamples));
+            image.setPixel(i, j, qRgb(gray, gray, gray));
+        }
+    }
     return image;
 }
 
@@ -125,13 +274,20 @@ Vec3Df RayTracer::computePixel(const Vec3Df & camPos,
                                unsigned int screenWidth,
                                unsigned int screenHeight,
                                const vector<pair<float, float>> &offsets,
+                               const vector<float> &times,
                                const vector<pair<float, float>> &offsets_focus,
                                float focalDistance,
                                unsigned i, unsigned j) const {
     Color c;
+    const Brdf::Type type = onlyAmbientOcclusion?Brdf::Ambient:Brdf::All;
+
+    // Every sample the film holds averaged offsets.size() rays of one pass
+    const unsigned firstIndex = film.getNbSamples(i, j)*offsets.size();
 
     // For each ray in each pixel
-    for (const pair<float, float> &offset : offsets) {
+    for (unsigned s = 0; s < offsets.size(); s++) {
+        const unsigned index = firstIndex + s;
+        const pair<float, float> offset = getPixelOffset(i, j, index, offsets[s]);
         Vec3Df stepX = (float(i)+offset.first - screenWidth/2.f) * rightVec;
         Vec3Df stepY = (float(j)+offset.second - screenHeight/2.f) * upVec;
         Vec3Df step = stepX + stepY;
@@ -143,63 +299,193 @@ Vec3Df RayTracer::computePixel(const Vec3Df & camPos,
             dir.normalize ();
             Vec3Df customFocalPoint = camPos + (distanceCameraScreen*(distanceOrthogonalCameraScreen + focalDistance)/
                                                 distanceOrthogonalCameraScreen)*dir;
-            for (const pair<float, float> &offset_focus : offsets_focus) {
+            // With SOBOL, stochastic depth of field gives every sample its own lens positions
+            vector<pair<float, float>> ownOffsetsFocus;
+            if (samplerType == Sampler::SOBOL && typeFocus == Focus::STOCHASTIC) {
+                startSample(i, j, index, Sampler::LENS_DIMENSION);
+                ownOffsetsFocus = Focus::generateOffsets(typeFocus, apertureFocus, offsets_focus.size());
+            }
+            const vector<pair<float, float>> &lens = ownOffsetsFocus.empty() ? offsets_focus : ownOffsetsFocus;
+            for (unsigned f = 0; f < lens.size(); f++) {
+                const pair<float, float> &offset_focus = lens[f];
                 Vec3Df focusMovedCamPos = camPos + Vec3Df(1,0,0)*offset_focus.first + Vec3Df(0,1,0)*offset_focus.second;
                 dir = customFocalPoint - focusMovedCamPos;
                 dir.normalize();
-                c += getColor(dir, focusMovedCamPos);
+                Ray bestRay;
+                if (intersect(dir, focusMovedCamPos, bestRay, times[s], PRIMARY_RAY)) {
+                    startSample(i, j, index*lens.size() + f, Sampler::SHADING_DIMENSION);
+                    c += shade(focusMovedCamPos, bestRay, 0, type);
+                }
+                else {
+                    c += backgroundColor;
+                }
             }
         }
         else {
-            c += getColor(dir, camPos);
+            Ray bestRay;
+            if (intersect(dir, camPos, bestRay, times[s], PRIMARY_RAY)) {
+                startSample(i, j, index, Sampler::SHADING_DIMENSION);
+                c += shade(camPos, bestRay, 0, type);
+            }
+            else {
+                c += backgroundColor;
+            }
         }
     }
     return c();
 }
 
-bool RayTracer::intersect(const Vec3Df & dir,
-                          const Vec3Df & camPos,
-                          Ray & bestRay) const {
-    const Scene * scene = controller->getScene();
-    bestRay = Ray();
+void RayTracer::computeTile(const Vec3Df & camPos,
+                            const Vec3Df & direction,
+                            const Vec3Df & upVec,
+                            const Vec3Df & rightVec,
+                            unsigned int screenWidth,
+                            unsigned int screenHeight,
+                            const vector<pair<float, float>> &offsets,
+                            const vector<float> &times,
+                            const vector<pair<float, float>> &offsets_focus,
+                            float focalDistance,
+                            unsigned i, unsigned j, unsigned mask,
+                            Vec3Df *colors) const {
+    const unsigned tile = RayPacket::TILE;
+
+    // Depth of field rays do not share their origin, trace them one by one
+    if (typeFocus != Focus::NONE && quality == OPTIMAL) {
+        for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+            if (mask & (1u << k)) {
+                colors[k] = computePixel(camPos, direction, upVec, rightVec,
+                                         screenWidth, screenHeight,
+                                         offsets, times, offsets_focus, focalDistance,
+                                         i+k%tile, j+k/tile);
+            }
+        }
+        return;
+    }
 
+    const Brdf::Type type = onlyAmbientOcclusion?Brdf::Ambient:Brdf::All;
+    Color c[RayPacket::SIZE];
 
-    for (Object * o : scene->getObjects()) {
-        if (!o->isEnabled()) {
-            continue;
+    // For each ray in each pixel
+    for (unsigned s = 0; s < offsets.size(); s++) {
+        RayPacket packet;
+        for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+            unsigned pi = i+k%tile, pj = j+k/tile;
+            if (!(mask & (1u << k))) {
+                continue;
+            }
+            const pair<float, float> offset = getPixelOffset(pi, pj, film.getNbSamples(pi, pj)*offsets.size() + s, offsets[s]);
+            Vec3Df stepX = (float(pi)+offset.first - screenWidth/2.f) * rightVec;
+            Vec3Df stepY = (float(pj)+offset.second - screenHeight/2.f) * upVec;
+            Vec3Df dir = direction + stepX + stepY;
+            dir.normalize();
+            packet.set(k, Ray(camPos, dir, times[s]));
+        }
+
+        intersect(packet);
+
+        for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+            if (!packet.isActive(k)) {
+                continue;
+            }
+            Ray & ray = packet.rays[k];
+            if (ray.intersect()) {
+                unsigned pi = i+k%tile, pj = j+k/tile;
+                startSample(pi, pj, film.getNbSamples(pi, pj)*offsets.size() + s, Sampler::SHADING_DIMENSION);
+                c[k] += shade(camPos, ray, 0, type);
+            }
+            else {
+                c[k] += backgroundColor;
+            }
         }
-        Ray ray (camPos - o->getTrans ()+ DISTANCE_MIN_INTERSECT*dir, dir);
+    }
 
-        if (o->getKDtree().intersect(ray) &&
-            ray.getIntersectionDistance() < bestRay.getIntersectionDistance()) {
-            bestRay = ray;
+    for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+        colors[k] = c[k]();
+    }
+}
+
+bool RayTracer::intersect(RayPacket & packet) const {
+    const Scene * scene = controller->getScene();
+    countRays(PRIMARY_RAY, __builtin_popcount(packet.mask));
+    for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+        Ray & ray = packet.rays[k];
+        ray.getOrigin() += DISTANCE_MIN_INTERSECT*ray.getDirection();
+    }
+
+    bool hit = scene->getBVH().intersect(packet);
+
+    for (unsigned k = 0; k < RayPacket::SIZE; k++) {
+        Ray & ray = packet.rays[k];
+        if (packet.isActive(k) && ray.intersect()) {
+            ray.translate(ray.getIntersectedObject()->getTrans(ray.getTime()));
         }
     }
+    return hit;
+}
+
+bool RayTracer::intersect(const Vec3Df & dir,
+                          const Vec3Df & camPos,
+                          Ray & bestRay,
+                          float time,
+                          RayType type) const {
+    const Scene * scene = controller->getScene();
+    countRays(type);
+    scene->getBVH().intersect(camPos + DISTANCE_MIN_INTERSECT*dir, dir, time, bestRay);
 
     if(bestRay.intersect()) {
-        bestRay.translate(bestRay.getIntersectedObject()->getTrans());
+        bestRay.translate(bestRay.getIntersectedObject()->getTrans(time));
     }
 
     return bestRay.intersect();
 }
 
-Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, bool pathTracing) const {
+bool RayTracer::occluded(const Vec3Df & dir,
+                         const Vec3Df & pos,
+                         float maxDistance,
+                         float time,
+                         RayType type) const {
+    const Scene * scene = controller->getScene();
+    countRays(type);
+    return scene->getBVH().occluded(pos + DISTANCE_MIN_INTERSECT*dir, dir, time,
+                                    maxDistance - DISTANCE_MIN_INTERSECT);
+}
+
+Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, bool pathTracing, float time) const {
     Ray bestRay;
     Brdf::Type type = onlyAmbientOcclusion?Brdf::Ambient:Brdf::All;
-    bool useRayTracing = pathTracing;
-    return getColor(dir, camPos, bestRay, useRayTracing?0:depthPathTracing, type);
+    return getColor(dir, camPos, bestRay, time, pathTracing?0:MAX_DEPTH_PATH_TRACING, type);
 }
 
-Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & bestRay, unsigned depth, Brdf::Type type) const {
+Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & bestRay, float time,
+                           unsigned depth, Brdf::Type type) const {
 
 
-    if(!intersect(dir, camPos, bestRay)) {
+    if(!intersect(dir, camPos, bestRay, time)) {
         return backgroundColor;
     }
 
+    return shade(camPos, bestRay, depth, type);
+}
+
+Vec3Df RayTracer::shade(const Vec3Df & camPos, Ray & bestRay, unsigned depth, Brdf::Type type) const {
     // hit something
     const Material & mat = bestRay.getIntersectedObject()->getMaterial();
-    const vector<Light> & lights = getLights(bestRay.getIntersection());
+    const bool pathTracing = depthPathTracing && depth < MAX_DEPTH_PATH_TRACING;
+
+    // Lambertian reflectance of the hit, used as throughput of the bounce
+    Vec3Df albedo;
+    // Russian roulette past depthPathTracing, survivors make up for the others
+    float survival = 0.f;
+    if(pathTracing) {
+        albedo = intensityPathTracing*mat.getDiffuse()*mat.getColorTexture()->getColor(&bestRay);
+        survival = depth < depthPathTracing ? 1.f :
+            min(max(max(albedo[0], albedo[1]), albedo[2]), float(MAX_SURVIVAL_PATH_TRACING));
+    }
+    // Bounces reaching lights only count for materials lit by their Brdf alone
+    const bool mis = isNextEventEstimation() && mat.hasPlainBrdf() && survival > 0.f;
+
+    const vector<Light> & lights = getLights(bestRay.getIntersection(), bestRay.getTime(),
+                                             mis ? survival : 0.f);
 
     Color color = mat.genColor(camPos, &bestRay, lights, type);
 
@@ -210,16 +496,43 @@ Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & best
     }
 
     // PATH TRACING
-    if(depth < depthPathTracing) {
-        Vec3Df new_orig = bestRay.getIntersection().getPos();
-        Vec3Df new_dir = Vec3Df::getRandomOnHemisphere(bestRay.getIntersection().getNormal());
-
-        Vec3Df ptColor = getColor(new_dir, new_orig, bestRay, depth+1, Brdf::Diffuse);
-        if(ptColor != backgroundColor) {
-            float coeff = intensityPathTracing/pow(1.0 + bestRay.getIntersectionDistance(), 3*(depth+1));
-            ptColor *= coeff;
-            color += mat.getColorTexture()->getColor(&bestRay)*ptColor;
+    if(pathTracing) {
+        Vec3Df ptColor;
+        if(survival > 0.f && (survival == 1.f || Random::local().uniform() < survival)) {
+            const Vertex & hit = bestRay.getIntersection();
+            Vec3Df new_orig = hit.getPos();
+            // With cosine weighted directions, cosine and pdf cancel out
+            Vec3Df new_dir = hit.getNormal().cosineRotate(M_PI/2);
+
+            Ray bounce;
+            bool found = intersect(new_dir, new_orig, bounce, bestRay.getTime());
+            if(found) {
+                ptColor = albedo*shade(new_orig, bounce, depth+1, Brdf::Diffuse)/survival;
+            }
+
+            // The bounce as a sample of the lights it reaches, weighted against getLights
+            if(mis) {
+                const float hitDistance = found ? Vec3Df::distance(bounce.getIntersection().getPos(), new_orig) : INFINITY;
+                const float bounceDensity = survival*max(Vec3Df::dotProduct(new_dir, hit.getNormal()), 0.f)/float(M_PI);
+                const unsigned nbLights = lights.size()/shadow.nbImpulse;
+                for(const Light * light : controller->getScene()->getLights()) {
+                    float distance;
+                    if(!light->isEnabled() || !light->intersect(new_orig, new_dir, distance) ||
+                       distance >= hitDistance || bounceDensity == 0.f) {
+                        continue;
+                    }
+                    Light l = *light;
+                    l.setPos(new_orig + distance*new_dir);
+                    const float lightDensity = light->getDensity(new_dir, distance);
+                    const float weight = powerHeuristic(bounceDensity, shadow.nbImpulse*lightDensity);
+                    color = color() + mat.genColor(camPos, &bestRay, vector<Light>(1, l),
+                                                   Brdf::Type(type & ~Brdf::Ambient))*
+                        (weight*lightDensity/(bounceDensity*nbLights));
+                }
+            }
         }
+        // Color would average them
+        color = color() + ptColor;
         if(onlyPathTracing && depth == 0)
             color = ptColor;
     }
@@ -227,15 +540,34 @@ Vec3Df RayTracer::getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & best
     return color();
 }
 
-vector<Light> RayTracer::getLights(const Vertex & closestIntersection) const {
+vector<Light> RayTracer::getLights(const Vertex & closestIntersection, float time,
+                                  float bounceProbability) const {
     vector<Light *> lights = controller->getScene()->getLights();
     vector<Light> enabledLights;
+    const Vec3Df & pos = closestIntersection.getPos();
 
     for(Light * light : lights) {
         if (!light->isEnabled()) {
             continue;
         }
-        float visibility = shadow(closestIntersection.getPos(), *light);
+        if (isNextEventEstimation()) {
+            for (const Vec3Df & impulse : shadow.generateImpulsion(*light)) {
+                Vec3Df dir = impulse - pos;
+                float distance = dir.normalize();
+                float weight = 0.f;
+                if (!occluded(dir, pos, distance, time)) {
+                    float bounceDensity = bounceProbability*
+                        max(Vec3Df::dotProduct(dir, closestIntersection.getNormal()), 0.f)/float(M_PI);
+                    weight = powerHeuristic(shadow.nbImpulse*light->getDensity(dir, distance), bounceDensity);
+                }
+                Light l = *light;
+                l.setPos(impulse);
+                l.setIntensity(light->getIntensity()*weight);
+                enabledLights.push_back(l);
+            }
+            continue;
+        }
+        float visibility = shadow(closestIntersection.getPos(), *light, time);
         Light l = *light;
         l.setIntensity(light->getIntensity()*visibility);
         enabledLights.push_back(l);
@@ -244,26 +576,32 @@ vector<Light> RayTracer::getLights(const Vertex & closestIntersection) const {
     return enabledLights;
 }
 
-float RayTracer::getAmbientOcclusion(Vertex intersection) const {
+float RayTracer::getAmbientOcclusion(Vertex intersection, float time) const {
     if ((!nbRayAmbientOcclusion)||(quality!=OPTIMAL)) return intensityAmbientOcclusion;
 
     int occlusion = 0;
-    vector<Vec3Df> directions = intersection.getNormal().randRotate(maxAngleAmbientOcclusion,
-                                                                    nbRayAmbientOcclusion);
+    // Cosine weighted, so that the visible fraction estimates cosine weighted visibility
+    vector<Vec3Df> directions = intersection.getNormal().cosineRotate(maxAngleAmbientOcclusion,
+                                                                      nbRayAmbientOcclusion);
     for (Vec3Df & direction : directions) {
         const Vec3Df & pos = intersection.getPos();
 
-        Ray bestRay;
-        if (intersect(direction, pos, bestRay)) {
-            if (bestRay.getIntersectionDistance() < radiusAmbientOcclusion) {
-                occlusion++;
-            }
+        if (occluded(direction, pos, radiusAmbientOcclusion, time, SECONDARY_RAY)) {
+            occlusion++;
         }
     }
 
     return intensityAmbientOcclusion * (1.f-float(occlusion)/float(nbRayAmbientOcclusion));
 }
 
+unsigned long long RayTracer::getNbRays(RayType type) const {
+    unsigned long long n = 0;
+    for (unsigned t = 0; t < nbRayCounts; t++) {
+        n += rayCounts[t].n[type];
+    }
+    return n;
+}
+
 QString RayTracer::qualityToString(Quality quality, int qualityDivider) {
     switch (quality) {
     case OPTIMAL:
@@ -8,12 +8,15 @@
 #ifndef RAYTRACER_H
 #define RAYTRACER_H
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <QImage>
 #include <QString>
 #include <utility>
 #include <vector>
+#include <omp.h>
 
 #include "Vec3D.h"
 #include "Shadow.h"
@@ -21,11 +24,14 @@
 #include "AntiAliasing.h"
 #include "Focus.h"
 #include "Observable.h"
-#include "RenderThread.h"
+#include "TileScheduler.h"
+#include "Film.h"
+#include "Sampler.h"
 
 class Color;
 class Vertex;
-class Controller;
+class BaseController;
+class RayPacket;
 
 class RayTracer: public Observable {
 public:
@@ -52,9 +58,19 @@ public:
     static const unsigned long DURTIEST_QUALITY_DIVIDER_CHANGED = 1<<19;
     static const unsigned long BACKGROUND_CHANGED               = 1<<20;
     static const unsigned long SHADOW_CHANGED                   = 1<<21;
+    static const unsigned long PROGRESSIVE_CHANGED              = 1<<22;
+    static const unsigned long ADAPTIVE_ERROR_CHANGED           = 1<<23;
+    static const unsigned long SEED_CHANGED                     = 1<<24;
+    static const unsigned long SAMPLER_CHANGED                  = 1<<25;
+    static const unsigned long INTENSITY_PBGI_CHANGED           = 1<<26;
+
+    /** Samples every pixel gets before adaptive sampling picks noisy ones */
+    static const unsigned ADAPTIVE_MIN_SAMPLES = 4;
 
     enum Mode {PATH_TRACING_MODE = 0, PBGI_MODE};
     enum Quality {OPTIMAL, BASIC, ONE_OVER_X};
+    /** Shadow rays test lights, secondary rays are reflections, refractions, AO and path tracing */
+    enum RayType {PRIMARY_RAY = 0, SHADOW_RAY, SECONDARY_RAY, NB_RAY_TYPES};
 
     Mode getMode() const {return mode;}
     /** Change MODE_CHANGED */
@@ -63,6 +79,10 @@ public:
         setChanged(MODE_CHANGED);
     }
 
+    /**
+     * Bounces always traced, Russian roulette decides about the next ones
+     * 0 disables path tracing.
+     */
     unsigned getDepthPathTracing() const {return depthPathTracing;}
     /** Change DEPTH_PT_CHANGED */
     void setDepthPathTracing(unsigned d) {
@@ -84,6 +104,14 @@ public:
         setChanged(INTENSITY_PT_CHANGED);
     }
 
+    /** Intensity of the surfels lighting PBGI renders, apart from the path tracing one */
+    float getIntensityPBGI() const {return intensityPBGI;}
+    /** Change INTENSITY_PBGI_CHANGED */
+    void setIntensityPBGI(float i) {
+        intensityPBGI = i;
+        setChanged(INTENSITY_PBGI_CHANGED);
+    }
+
     bool isOnlyPathTracing() const {return onlyPathTracing;}
     /** Change ONLY_PT_CHANGED */
     void setOnlyPathTracing(bool o) {
@@ -161,6 +189,7 @@ public:
         setChanged(APERTURE_FOCUS_CHANGED);
     }
 
+    /** Motion blur: times sampled per pixel when objects are mobile */
     unsigned getNbPictures() const {return nbPictures;}
     /** Change NB_PICTURES_CHANGED */
     void setNbPictures(unsigned n) {
@@ -210,6 +239,48 @@ public:
     }
     unsigned getShadowNbImpulse() const {return shadow.nbImpulse;}
 
+    /**
+     * Renders of the same view at OPTIMAL quality add one ray per pixel to
+     * the film instead of starting over, as real time path tracing does
+     */
+    bool isProgressive() const {return progressive;}
+    /** Change PROGRESSIVE_CHANGED */
+    void setProgressive(bool p) {
+        progressive = p;
+        setChanged(PROGRESSIVE_CHANGED);
+    }
+
+    /**
+     * Error of Film::getError(i, j) under which anti aliasing stops adding
+     * samples to a pixel, 0 to always use all of them
+     */
+    float getAdaptiveError() const {return adaptiveError;}
+    /** Change ADAPTIVE_ERROR_CHANGED */
+    void setAdaptiveError(float e) {
+        adaptiveError = e;
+        setChanged(ADAPTIVE_ERROR_CHANGED);
+    }
+
+    /** Renders with the same seed and settings give the same picture */
+    unsigned getSeed() const {return seed;}
+    /** Change SEED_CHANGED */
+    void setSeed(unsigned s) {
+        seed = s;
+        setChanged(SEED_CHANGED);
+    }
+
+    Sampler::Type getSamplerType() const {return samplerType;}
+    /** Change SAMPLER_CHANGED */
+    void setSamplerType(Sampler::Type t) {
+        samplerType = t;
+        setChanged(SAMPLER_CHANGED);
+    }
+
+    /** Samples of the last renders, see isProgressive */
+    const Film & getFilm() const {return film;}
+    /** Gray picture of the number of samples of each pixel of the film, white for the most */
+    QImage getSampleDensity() const;
+
     const Vec3Df & getBackgroundColor () const { return backgroundColor;}
     /** Change BACKGROUND_CHANGED */
     void setBackgroundColor (const Vec3Df & c) {
@@ -217,6 +288,7 @@ public:
         setChanged(BACKGROUND_CHANGED);
     }
 
+    /** If tiles is given, it receives the rendered tiles and their rendering times */
     QImage render (const Vec3Df & camPos,
                    const Vec3Df & viewDirection,
                    const Vec3Df & upVector,
@@ -224,7 +296,8 @@ public:
                    float fieldOfView,
                    float aspectRatio,
                    unsigned int screenWidth,
-                   unsigned int screenHeight) const;
+                   unsigned int screenHeight,
+                   std::vector<TileScheduler::Tile> *tiles = nullptr) const;
 
     inline Vec3Df computePixel(const Vec3Df & camPos,
                                const Vec3Df & direction,
@@ -233,18 +306,82 @@ public:
                                unsigned int screenWidth,
                                unsigned int screenHeight,
                                const std::vector<std::pair<float, float>> &offsets,
+                               const std::vector<float> &times,
                                const std::vector<std::pair<float, float>> &offsets_focus,
                                float focalDistance,
                                unsigned i, unsigned j) const;
 
+    /**
+     * Compute the colors of a RayPacket::TILE sided square of pixels starting at i, j
+     * Camera rays are traced as a packet unless depth of field is used
+     * Pixel k of the square, row by row, is computed only if bit k of mask is set
+     */
+    void computeTile(const Vec3Df & camPos,
+                     const Vec3Df & direction,
+                     const Vec3Df & upVec,
+                     const Vec3Df & rightVec,
+                     unsigned int screenWidth,
+                     unsigned int screenHeight,
+                     const std::vector<std::pair<float, float>> &offsets,
+                     const std::vector<float> &times,
+                     const std::vector<std::pair<float, float>> &offsets_focus,
+                     float focalDistance,
+                     unsigned i, unsigned j, unsigned mask,
+                     Vec3Df *colors) const;
+
+    /**
+     * Mark pixels of the film above adaptiveError and their neighbors
+     * Return false if there is none.
+     */
+    bool selectNoisyPixels(std::vector<unsigned char> &active) const;
+
+    /**
+     * Start the sampler of the calling thread on sample index of pixel i, j
+     * Indices go on after the samples already in the film, so that every
+     * pass gets new ones.
+     */
+    inline void startSample(unsigned i, unsigned j, unsigned index, unsigned dimension) const {
+        Sampler::local().start(samplerType, Random::hash(seed, j*film.getWidth()+i), index, dimension);
+    }
+
+    /**
+     * Position in pixel i, j of its sample index, whose offset in the shared pattern is given
+     * With SOBOL, stochastic anti aliasing gives every pixel its own positions.
+     */
+    inline std::pair<float, float> getPixelOffset(unsigned i, unsigned j, unsigned index,
+                                                  const std::pair<float, float> &offset) const {
+        if (samplerType != Sampler::SOBOL || typeAntiAliasing != AntiAliasing::STOCHASTIC ||
+            quality != OPTIMAL) {
+            return offset;
+        }
+        startSample(i, j, index, Sampler::PIXEL_DIMENSION);
+        return Sampler::local().get2D();
+    }
+
+    /** time places mobile objects along their motion, see Ray */
     bool intersect(const Vec3Df & dir,
                    const Vec3Df & camPos,
-                   Ray & bestRay) const;
+                   Ray & bestRay,
+                   float time = 0.f,
+                   RayType type = SECONDARY_RAY) const;
+
+    /** Same as above for every active ray of packet, counted as primary rays */
+    bool intersect(RayPacket & packet) const;
+
+    /**
+     * True if an opaque object lies on the ray before pos + maxDistance*dir
+     * Stops at the first hit found, dir has to be normalized
+     */
+    bool occluded(const Vec3Df & dir, const Vec3Df & pos, float maxDistance, float time,
+                  RayType type = SHADOW_RAY) const;
 
-    Vec3Df getColor(const Vec3Df & dir, const Vec3Df & camPos, bool pathTracing = true) const;
-    float getAmbientOcclusion(Vertex pos) const;
+    /** Number of rays of a type traced since the last render started */
+    unsigned long long getNbRays(RayType type) const;
 
-    RayTracer(Controller *c);
+    Vec3Df getColor(const Vec3Df & dir, const Vec3Df & camPos, bool pathTracing = true, float time = 0.f) const;
+    float getAmbientOcclusion(Vertex pos, float time) const;
+
+    RayTracer(BaseController *c);
     virtual ~RayTracer () {}
 
     static QString qualityToString(Quality quality, int qualityDivider);
@@ -256,6 +393,7 @@ private:
     unsigned nbRayPathTracing;
     float intensityPathTracing;
     bool onlyPathTracing;
+    float intensityPBGI;
 
     float radiusAmbientOcclusion;
     unsigned nbRayAmbientOcclusion;
@@ -278,15 +416,82 @@ private:
     Quality durtiestQuality;
     Vec3Df backgroundColor;
     Shadow shadow;
+    bool progressive;
+    float adaptiveError;
+    unsigned seed;
+    Sampler::Type samplerType;
     /*        End Config         */
 
-    Controller *controller;
+    BaseController *controller;
 
     static constexpr float DISTANCE_MIN_INTERSECT = 0.000001f;
+    /** Path tracing stops there even if Russian roulette does not */
+    static const unsigned MAX_DEPTH_PATH_TRACING = 32;
+    static constexpr float MAX_SURVIVAL_PATH_TRACING = 0.95f;
     static constexpr float distanceOrthogonalCameraScreen = 1.0;
 
-    Vec3Df getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & bestRay, unsigned depth = 0, Brdf::Type type = Brdf::All) const;
-    std::vector<Light> getLights(const Vertex & closestIntersection) const;
+    /** Ray counts of one thread, on a cache line of its own */
+    class alignas(64) RayCounts {
+    public:
+        unsigned long long n[8];
+    };
+    /**
+     * One RayCounts per thread of the team rendering, by thread number
+     * Rays traced at the same time by other teams, nested or run by other
+     * threads such as the GUI, share these counts without synchronization
+     * and may be miscounted.
+     */
+    unsigned nbRayCounts;
+    /** new only aligns to 16 bytes before C++17, rayCounts is aligned inside */
+    std::unique_ptr<char[]> rayCountsStorage;
+    RayCounts *rayCounts;
+
+    /** What the film holds, progressive renders of another view start over */
+    class View {
+    public:
+        Vec3Df camPos, direction, upVector;
+        float fieldOfView, aspectRatio;
+        inline bool operator!=(const View &v) const {
+            return camPos != v.camPos || direction != v.direction || upVector != v.upVector ||
+                fieldOfView != v.fieldOfView || aspectRatio != v.aspectRatio;
+        }
+    };
+    mutable Film film;
+    mutable View filmView;
+    inline void countRays(RayType type, unsigned n = 1) const {
+        rayCounts[omp_get_thread_num()%nbRayCounts].n[type] += n;
+    }
+
+    Vec3Df getColor(const Vec3Df & dir, const Vec3Df & camPos, Ray & bestRay, float time,
+                    unsigned depth = 0, Brdf::Type type = Brdf::All) const;
+    /** Color of the hit of bestRay, already intersected */
+    Vec3Df shade(const Vec3Df & camPos, Ray & bestRay, unsigned depth, Brdf::Type type) const;
+    /**
+     * Enabled lights seen from closestIntersection, dimmed by their shadows
+     * With next event estimation, each light is replaced by shadow.nbImpulse
+     * points of its disc. If a bounce is traced with probability
+     * bounceProbability, they are weighted against it, see shade.
+     */
+    std::vector<Light> getLights(const Vertex & closestIntersection, float time,
+                                 float bounceProbability = 0.f) const;
+
+    /**
+     * Path traced soft shadows sample the discs of the lights at every hit,
+     * and combine them with cosine weighted bounces hitting the discs by
+     * multiple importance sampling
+     */
+    inline bool isNextEventEstimation() const {
+        return mode == PATH_TRACING_MODE && quality == OPTIMAL && depthPathTracing &&
+            shadow.mode == Shadow::SOFT && shadow.nbImpulse;
+    }
+
+    /** Multiple importance sampling weight of the strategy of density p against the one of density q */
+    static inline float powerHeuristic(float p, float q) {
+        if (std::isinf(p)) {
+            return 1.f;
+        }
+        return p*p/(p*p + q*q);
+    }
 };
 
 
@@ -0,0 +1,29 @@
+#include "RenderMesh.h"
+#include "Mesh.h"
+
+using namespace std;
+
+RenderMesh::RenderMesh(const Mesh &mesh):
+    positions(VERTEX_STRIDE*mesh.getVertices().size(), 0.f),
+    normals(VERTEX_STRIDE*mesh.getVertices().size(), 0.f),
+    uvs(UV_STRIDE*mesh.getTriangles().size()),
+    indices(3*mesh.getTriangles().size()),
+    uScale(mesh.getUScale()),
+    vScale(mesh.getVScale()) {
+    const vector<Vertex> &vertices = mesh.getVertices();
+    for (unsigned i = 0; i < vertices.size(); i++) {
+        for (unsigned k = 0; k < 3; k++) {
+            positions[VERTEX_STRIDE*i+k] = vertices[i].getPos()[k];
+            normals[VERTEX_STRIDE*i+k] = vertices[i].getNormal()[k];
+        }
+    }
+
+    const vector<Triangle> &triangles = mesh.getTriangles();
+    for (unsigned t = 0; t < triangles.size(); t++) {
+        for (unsigned k = 0; k < 3; k++) {
+            indices[3*t+k] = triangles[t].getVertex(k);
+            uvs[UV_STRIDE*t+2*k] = triangles[t].getU(k);
+            uvs[UV_STRIDE*t+2*k+1] = triangles[t].getV(k);
+        }
+    }
+}
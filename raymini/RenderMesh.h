@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "Vec3D.h"
+
+class Mesh;
+
+/** Allocator of std::vector storage aligned for SIMD loads */
+template<class T, size_t ALIGNMENT = 32>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    template<class U> struct rebind { typedef AlignedAllocator<U, ALIGNMENT> other; };
+
+    AlignedAllocator() {}
+    template<class U> AlignedAllocator(const AlignedAllocator<U, ALIGNMENT> &) {}
+
+    T * allocate(size_t n) {
+        void *p = nullptr;
+        if (posix_memalign(&p, ALIGNMENT, n*sizeof(T))) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(p);
+    }
+    void deallocate(T *p, size_t) { free(p); }
+
+    template<class U> bool operator==(const AlignedAllocator<U, ALIGNMENT> &) const { return true; }
+    template<class U> bool operator!=(const AlignedAllocator<U, ALIGNMENT> &) const { return false; }
+};
+
+/**
+ * Copy of a Mesh laid out for rendering
+ *
+ * Positions, normals, triangle indices and texture coordinates are separate
+ * dense streams of aligned floats, so that hits are shaded without going
+ * through Vertex and Triangle.
+ * Positions and normals take 4 floats per vertex, texture coordinates
+ * (u, v) of the 3 corners of each triangle take 6 floats.
+ * Barycentric coordinates (u, v) are the ones of Ray: the hit point is
+ * c + u (a - c) + v (b - c) for the corners a, b, c of the triangle.
+ */
+class RenderMesh {
+public:
+    typedef std::vector<float, AlignedAllocator<float>> Stream;
+
+    static const unsigned VERTEX_STRIDE = 4;
+    static const unsigned UV_STRIDE = 6;
+
+    RenderMesh(): uScale(1), vScale(1) {}
+    RenderMesh(const Mesh &mesh);
+
+    inline unsigned getNbVertices() const { return positions.size()/VERTEX_STRIDE; }
+    inline unsigned getNbTriangles() const { return indices.size()/3; }
+
+    inline unsigned getVertex(unsigned triangle, unsigned corner) const {
+        return indices[3*triangle+corner];
+    }
+    inline Vec3Df getPosition(unsigned vertex) const {
+        const float *p = &positions[VERTEX_STRIDE*vertex];
+        return Vec3Df(p[0], p[1], p[2]);
+    }
+    inline Vec3Df getNormal(unsigned vertex) const {
+        const float *n = &normals[VERTEX_STRIDE*vertex];
+        return Vec3Df(n[0], n[1], n[2]);
+    }
+
+    /** Point at barycentric coordinates u, v of triangle, as the intersection kernels compute it */
+    inline Vec3Df interpolatePosition(unsigned triangle, float u, float v) const {
+        const Vec3Df a = getPosition(getVertex(triangle, 0));
+        const Vec3Df b = getPosition(getVertex(triangle, 1));
+        const Vec3Df c = getPosition(getVertex(triangle, 2));
+        return c + u*(a - c) + v*(b - c);
+    }
+
+    /** Normal at barycentric coordinates u, v of triangle, normalized */
+    inline Vec3Df interpolateNormal(unsigned triangle, float u, float v) const {
+        const float *na = &normals[VERTEX_STRIDE*indices[3*triangle]];
+        const float *nb = &normals[VERTEX_STRIDE*indices[3*triangle+1]];
+        const float *nc = &normals[VERTEX_STRIDE*indices[3*triangle+2]];
+        const float w = 1.f - u - v;
+        Vec3Df normal(u*na[0] + v*nb[0] + w*nc[0],
+                      u*na[1] + v*nb[1] + w*nc[1],
+                      u*na[2] + v*nb[2] + w*nc[2]);
+        normal.normalize();
+        return normal;
+    }
+
+    /** Texture coordinates at barycentric coordinates u, v of triangle */
+    inline void interpolateUV(unsigned triangle, float u, float v, float &texU, float &texV) const {
+        const float *t = &uvs[UV_STRIDE*triangle];
+        texU = t[4] + (t[0] - t[4])*u + (t[2] - t[4])*v;
+        texV = t[5] + (t[1] - t[5])*u + (t[3] - t[5])*v;
+    }
+
+    inline float getUScale() const { return uScale; }
+    inline float getVScale() const { return vScale; }
+
+private:
+    Stream positions;
+    Stream normals;
+    Stream uvs;
+    std::vector<unsigned, AlignedAllocator<unsigned>> indices;
+    float uScale;
+    float vScale;
+};
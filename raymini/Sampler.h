@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include "Random.h"
+
+/**
+ * Random numbers of the samples of a pixel
+ *
+ * A sample uses pairs of dimensions in turn: position in the pixel, on the
+ * lens, then one for each light, ambient occlusion or path tracing ray
+ * shot while shading it. SOBOL takes each pair from the first two Sobol
+ * dimensions, Owen scrambled with a seed per pixel and dimension, with
+ * the index shuffled too (Burley, Practical Hash-Based Owen Scrambling),
+ * so that the samples of a pixel are stratified in every pair while pixels
+ * and pairs stay uncorrelated. RANDOM draws from Random.
+ * Every thread has its own sampler, see local().
+ */
+class Sampler {
+public:
+    enum Type {RANDOM = 0, SOBOL};
+
+    static const unsigned PIXEL_DIMENSION = 0;
+    static const unsigned LENS_DIMENSION = 1;
+    static const unsigned SHADING_DIMENSION = 2;
+
+    Sampler(): type(RANDOM), seed(0), index(0), dimension(0) {}
+
+    /** Go to dimension of sample index of the pixel seeded by s, Random::local() is seeded too */
+    inline void start(Type t, uint64_t s, unsigned i, unsigned d) {
+        type = t;
+        seed = s;
+        index = i;
+        dimension = d;
+        Random::local().seed(Random::hash(Random::hash(s, i), d));
+    }
+
+    /** Point of the sample in the next pair of dimensions, in [0, 1[^2 */
+    inline std::pair<float, float> get2D() {
+        std::pair<float, float> point;
+        get2D(1, &point);
+        return point;
+    }
+
+    /** nb points spread over the next pair of dimensions, for several rays of the same sample */
+    void get2D(unsigned nb, std::pair<float, float> *points) {
+        if (type == RANDOM) {
+            Random &random = Random::local();
+            for (unsigned k = 0; k < nb; k++) {
+                points[k].first = random.uniform();
+                points[k].second = random.uniform();
+            }
+        }
+        else {
+            const uint64_t h = Random::hash(seed, dimension);
+            const uint32_t indexSeed = uint32_t(h), xSeed = uint32_t(h >> 32);
+            const uint32_t ySeed = uint32_t(Random::hash(h, 0));
+            for (unsigned k = 0; k < nb; k++) {
+                const uint32_t i = scramble(index*nb + k, indexSeed);
+                points[k].first = toFloat(scramble(reverseBits(i), xSeed));
+                points[k].second = toFloat(scramble(sobol1(i), ySeed));
+            }
+        }
+        dimension++;
+    }
+
+    /** Sampler of the calling thread */
+    static inline Sampler & local() {
+        static thread_local Sampler sampler;
+        return sampler;
+    }
+
+private:
+    Type type;
+    uint64_t seed;
+    unsigned index;
+    unsigned dimension;
+
+    static inline uint32_t reverseBits(uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    /** Second Sobol dimension of point i, the first one is reverseBits(i) */
+    static inline uint32_t sobol1(uint32_t i) {
+        uint32_t x = 0;
+        for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1) {
+            if (i & 1) {
+                x ^= v;
+            }
+        }
+        return x;
+    }
+
+    /** Owen scrambling: each bit is flipped depending on the bits above it only */
+    static inline uint32_t scramble(uint32_t x, uint32_t s) {
+        x = reverseBits(x);
+        // Laine-Karras permutation, only changes bits from lower ones
+        x += s;
+        x ^= x*0x6c50b47cu;
+        x ^= x*0xb82f1e52u;
+        x ^= x*0xc7afe638u;
+        x ^= x*0x8d22f6e6u;
+        return reverseBits(x);
+    }
+
+    static inline float toFloat(uint32_t x) { return float(x >> 8)*(1.f/16777216.f); }
+};
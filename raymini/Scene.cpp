@@ -36,7 +36,7 @@ void printUsage(char * name) {
     exit(1);
 }
 
-Scene::Scene(Controller *c, int argc, char **argv) :
+Scene::Scene(BaseController *c, int argc, char **argv) :
     controller(c)
 {
     basicNormal = new MeshNormalTexture();
@@ -133,6 +133,7 @@ Scene::Scene(Controller *c, int argc, char **argv) :
     else printUsage(argv[0]);
 
     updateBoundingBox();
+    updateBVH();
     setChanged(OBJECT_CHANGED);
     setChanged(LIGHT_CHANGED);
     setChanged(MATERIAL_CHANGED);
@@ -177,7 +178,7 @@ void Scene::updateBoundingBox () {
 
 void Scene::buildRoom(Material *sphereMat) {
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
 
     objects.push_back(new Object(groundMesh, white, "Ground"));
@@ -199,7 +200,7 @@ void Scene::buildRoom(Material *sphereMat) {
 
     if(sphereMat) {
         Mesh sphereMesh;
-        sphereMesh.loadOFF("models/sphere.off");
+        sphereMesh.load("models/sphere.off");
         auto sphere = new Object(sphereMesh, sphereMat, "Sphere", {0, 0, 1});
         auto glass = dynamic_cast<Glass*>(sphereMat);
         if(glass) {
@@ -215,7 +216,7 @@ void Scene::buildRoom(Material *sphereMat) {
 
 void Scene::buildMesh(const std::string & path, Material *mat) {
     Mesh mesh;
-    mesh.loadOFF(path);
+    mesh.load(path);
     mesh.scale(1.f/Object::computeBoundingBox(mesh).getRadius());
     objects.push_back(new Object(mesh, mat, path));
 
@@ -230,12 +231,12 @@ void Scene::buildMultiLights() {
     materials.push_back(ramMat);
 
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
     objects.push_back(new Object(groundMesh, white, "Ground"));
 
     Mesh ramMesh;
-    ramMesh.loadOFF("models/ram.off");
+    ramMesh.load("models/ram.off");
     objects.push_back(new Object(ramMesh, ramMat, "Ram"));
 
     lights.push_back(new Light({0.f, -3.f, 3.f}, 0.01, {0.f, 0.f, 1.f},
@@ -257,7 +258,7 @@ void Scene::buildMultiMeshs() {
     materials.push_back(gargMat);
 
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
     // Use texture 5 times in each dimension
     groundMesh.setUVScales(5, 5);
@@ -275,15 +276,15 @@ void Scene::buildMultiMeshs() {
     objects.push_back(new Object(wallMesh, red, "Back wall", {0.f, 1.95251f, 1.5}));
 
     Mesh ramMesh;
-    ramMesh.loadOFF("models/ram.off");
+    ramMesh.load("models/ram.off");
     objects.push_back(new Object(ramMesh, ramMat, "Ram", {-1.f, 0.f, 0.f}, {0,-.5,0}));
 
     Mesh gargMesh;
-    gargMesh.loadOFF("models/gargoyle.off");
+    gargMesh.load("models/gargoyle.off");
     objects.push_back(new Object(gargMesh, gargMat, "Gargoyle", {-1.f, 1.0f, 0.f}));
 
     Mesh rhinoMesh;
-    rhinoMesh.loadOFF("models/rhino.off");
+    rhinoMesh.load("models/rhino.off");
     objects.push_back(new Object(rhinoMesh, rhinoMat, "Rhino", {1.f, 0.f, 0.4f}));
 
     Object *skybox = SkyBox::generateSkyBox(skyBoxMaterial);
@@ -295,7 +296,7 @@ void Scene::buildMultiMeshs() {
 
 void Scene::buildOutdor() {
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
     groundMesh.scale(5);
     groundMesh.setSquareTextureMapping();
@@ -304,13 +305,13 @@ void Scene::buildOutdor() {
     objects.push_back(new Object(groundMesh, groundMat, "Ground"));
 
     Mesh wallMesh;
-    wallMesh.loadOFF("models/wall.off");
+    wallMesh.load("models/wall.off");
     wallMesh.setSquareTextureMapping();
     wallMesh.setSquareTextureMapping();
     objects.push_back(new Object(wallMesh, mirrorMat, "Left wall", {-2.f, 0.f, 1.5f}));
 
     Mesh rhinoMesh;
-    rhinoMesh.loadOFF("models/rhino.off");
+    rhinoMesh.load("models/rhino.off");
     objects.push_back(new Object(rhinoMesh, rhinoMat, "Rhino", {1.f, 0.f, 0.4f}));
 
     Object *skybox = SkyBox::generateSkyBox(skyBoxMaterial);
@@ -332,10 +333,10 @@ void Scene::buildPool() {
     };
 
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
     Mesh sphereMesh;
-    sphereMesh.loadOFF("models/sphere.off");
+    sphereMesh.load("models/sphere.off");
 
     const float height = Object::computeBoundingBox(sphereMesh).getHeight()/2;
     const float delta = sqrt(3.f)*height;
@@ -365,7 +366,7 @@ void Scene::buildPool() {
 
 void Scene::buildSphere() {
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
     groundMesh.scale(2.0);
 
@@ -374,7 +375,7 @@ void Scene::buildSphere() {
     float rayon = 0.5;
 
     Mesh sphereMesh;
-    sphereMesh.loadOFF("models/sphere.off");
+    sphereMesh.load("models/sphere.off");
     sphereMesh.scale(rayon);
     auto sphere1 = new Object(sphereMesh, red, "Sphere1", {0, 0, rayon});
     objects.push_back(sphere1);
@@ -424,7 +425,7 @@ void Scene::buildMirrorGlass() {
     materials.push_back(glassMat);
 
     Mesh groundMesh;
-    groundMesh.loadOFF("models/ground.off");
+    groundMesh.load("models/ground.off");
     groundMesh.setSquareTextureMapping();
 
     objects.push_back(new Object(groundMesh, groundMat, "Ground"));
@@ -445,12 +446,12 @@ void Scene::buildMirrorGlass() {
     objects.push_back(new Object(groundMesh, mirrorMat, "Mirror Wall", {0, -2, 2}));
 
     Mesh sphereMesh;
-    sphereMesh.loadOFF("models/sphere.off");
+    sphereMesh.load("models/sphere.off");
 
     objects.push_back(new Object(sphereMesh, groundMat, "Pedestal"));
 
     Mesh ramMesh;
-    ramMesh.loadOFF("models/ram.off");
+    ramMesh.load("models/ram.off");
     objects.push_back(new Object(ramMesh, ramMat, "Ram", {0.f, 0.f, .85f}));
 
     sphereMesh.scale(0.5);
@@ -17,9 +17,10 @@
 #include "Vec3D.h"
 #include "Observable.h"
 #include "Material.h"
+#include "BVH.h"
 
 
-class Controller;
+class BaseController;
 
 class Scene: public Observable {
 public:
@@ -62,17 +63,12 @@ public:
         return false;
     }
 
-    void move(unsigned nbImages) {
-        for (auto o : objects)
-            o->move(nbImages);
-    }
-
-    void reset() {
-        for (auto o : objects)
-            o->reset();
-    }
+    /** Top level acceleration structure over objects */
+    inline const BVH & getBVH() const { return bvh; }
+    /** Refit or rebuild the BVH, to call whenever OBJECT_CHANGED is set */
+    void updateBVH() { bvh.update(objects); }
 
-    Scene(Controller *, int argc, char **argv);
+    Scene(BaseController *, int argc, char **argv);
     virtual ~Scene ();
 
     /** Return the index of the material of an object, -1 if not found */
@@ -98,7 +94,7 @@ private:
     Glass *glassMat;
     std::vector<Material *> materials;
 
-    Controller *controller;
+    BaseController *controller;
 
     void buildRoom(Material *sphereMat=nullptr);
     void buildMultiLights();
@@ -121,6 +117,7 @@ private:
     ImageNormalTexture *crossNormal;
     std::vector<NormalTexture *> normalTextures;
     BoundingBox bbox;
+    BVH bvh;
 };
 
 
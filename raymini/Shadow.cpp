@@ -1,29 +1,23 @@
 #include "Shadow.h"
 
 #include "RayTracer.h"
-#include "Material.h"
+#include "Sampler.h"
 
 using namespace std;
 
-bool Shadow::hard(const Vec3Df & pos, const Vec3Df& light) const {
-    Ray riShadow;
-
+bool Shadow::hard(const Vec3Df & pos, const Vec3Df& light, float time) const {
     Vec3Df dir = light - pos;
     float dist = dir.normalize();
 
-    bool inter = rt->intersect(dir, pos, riShadow);
-    if(inter && dynamic_cast<const Glass *>(&riShadow.getIntersectedObject()->getMaterial()))
-        return true;
-
-    return !inter || (inter && riShadow.getIntersectionDistance() > dist);
+    return !rt->occluded(dir, pos, dist, time);
 }
 
-float Shadow::soft(const Vec3Df & pos, const Light & light) const {
+float Shadow::soft(const Vec3Df & pos, const Light & light, float time) const {
     unsigned int nb_impact = 0;
     vector<Vec3Df> pulse_light = generateImpulsion(light);
 
     for(const Vec3Df & impulse_l : pulse_light)
-        nb_impact += int(!hard(pos, impulse_l));
+        nb_impact += int(!hard(pos, impulse_l, time));
 
     return float(nbImpulse - nb_impact) / float(nbImpulse);
 }
@@ -31,27 +25,28 @@ float Shadow::soft(const Vec3Df & pos, const Light & light) const {
 std::vector<Vec3Df> Shadow::generateImpulsion(const Light & light) const{
     std::vector<Vec3Df> impulsion;
     impulsion.resize(nbImpulse);
-    auto random = []() {
-        return float(rand())/float(RAND_MAX);
-    };//rand in [0,1[
-
+    vector<pair<float, float>> samples(nbImpulse);
+    Sampler::local().get2D(nbImpulse, samples.data());
+
+    // Uniform on the disc of the light
+    Vec3Df u = light.getNormal().getOrthogonal();
+    u.normalize();
+    Vec3Df v = Vec3Df::crossProduct(light.getNormal(), u);
+    v.normalize();
     for(unsigned int i = 0 ; i < nbImpulse ; i++) {
-        Vec3Df r(random(), random(), random());
-        r = r.projectOn(light.getNormal());
-        r.normalize();
-        float norm = 2*random()-1.f;
-        r = light.getRadius()*norm*r;
-        impulsion[i] = light.getPos() + r;
+        float radius = light.getRadius()*sqrt(samples[i].first);
+        float angle = 2*M_PI*samples[i].second;
+        impulsion[i] = light.getPos() + radius*cos(angle)*u + radius*sin(angle)*v;
     }
     return impulsion;
 }
 
-float Shadow::operator()(const Vec3Df & pos, const Light & light) const {
+float Shadow::operator()(const Vec3Df & pos, const Light & light, float time) const {
     bool noSoft = rt->getQuality() != RayTracer::Quality::OPTIMAL;
     if(mode == HARD || ((mode==SOFT) && noSoft))
-        return float(hard(pos, light.getPos()));
+        return float(hard(pos, light.getPos(), time));
     else if(mode == SOFT) {
-        return soft(pos, light);
+        return soft(pos, light, time);
     }
     return 1.0;
 }
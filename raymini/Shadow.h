@@ -16,12 +16,15 @@ public:
 
     Shadow(RayTracer *rt) : mode(NONE), nbImpulse(10), rt(rt) {}
 
-    float operator()(const Vec3Df & pos, const Light & light) const;
+    /** Visibility of light from pos, with mobile objects placed at time */
+    float operator()(const Vec3Df & pos, const Light & light, float time) const;
+
+    /** nbImpulse points on the disc of light, see Sampler */
+    std::vector<Vec3Df> generateImpulsion(const Light & light) const;
 
 private:
     class RayTracer *rt;
 
-    bool hard(const Vec3Df & pos, const Vec3Df & light) const;
-    float soft(const Vec3Df & pos, const Light & light) const;
-    std::vector<Vec3Df> generateImpulsion(const Light & light) const;
+    bool hard(const Vec3Df & pos, const Vec3Df & light, float time) const;
+    float soft(const Vec3Df & pos, const Light & light, float time) const;
 };
@@ -18,28 +18,10 @@ T MappedTexture<T>::getValue(Ray *intersectingRay) const {
         return T();
     }
 
-    const Triangle *t = intersectingRay->getTriangle();
-
-    // TODO implement Vec2D...
-    float uA = t->getU(0);
-    float vA = t->getV(0);
-    float uB = t->getU(1);
-    float vB = t->getV(1);
-    float uC = t->getU(2);
-    float vC = t->getV(2);
-
-    float interCA = intersectingRay->getU();
-    float interCB = intersectingRay->getV();
-
-    float uCA = uA - uC;
-    float vCA = vA - vC;
-    float uCB = uB - uC;
-    float vCB = vB - vC;
-
-    float interU = uC + uCA * interCA + uCB * interCB;
-    float interV = vC + vCA * interCA + vCB * interCB;
-
-    const Mesh &mesh = intersectingRay->getIntersectedObject()->getMesh();
+    const RenderMesh &mesh = intersectingRay->getIntersectedObject()->getRenderMesh();
+    float interU, interV;
+    mesh.interpolateUV(intersectingRay->getTriangle(), intersectingRay->getU(), intersectingRay->getV(),
+                       interU, interV);
 
     adaptUV(interU, interV, mesh.getUScale(), mesh.getVScale());
 
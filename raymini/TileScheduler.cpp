@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+
+#include "TileScheduler.h"
+
+using namespace std;
+
+TileScheduler::TileScheduler(unsigned width, unsigned height, unsigned nbThreads):
+    queues(max(nbThreads, 1u)),
+    locks(max(nbThreads, 1u)) {
+    const unsigned nbTilesX = (width+TILE_SIZE-1)/TILE_SIZE;
+    const unsigned nbTilesY = (height+TILE_SIZE-1)/TILE_SIZE;
+    for (unsigned ty = 0; ty < nbTilesY; ty++) {
+        for (unsigned tx = 0; tx < nbTilesX; tx++) {
+            Tile t;
+            t.x = tx*TILE_SIZE;
+            t.y = ty*TILE_SIZE;
+            t.width = min(unsigned(TILE_SIZE), width-t.x);
+            t.height = min(unsigned(TILE_SIZE), height-t.y);
+            t.time = 0;
+            tiles.push_back(t);
+        }
+    }
+
+    // Spiral: by square ring around the center, then by angle in the ring
+    const float cx = (nbTilesX-1)/2.f, cy = (nbTilesY-1)/2.f;
+    auto ring = [&](const Tile &t) {
+        return max(fabs(t.x/TILE_SIZE-cx), fabs(t.y/TILE_SIZE-cy));
+    };
+    auto angle = [&](const Tile &t) {
+        return atan2(t.y/TILE_SIZE-cy, t.x/TILE_SIZE-cx);
+    };
+    stable_sort(tiles.begin(), tiles.end(), [&](const Tile &a, const Tile &b) {
+        float ra = ring(a), rb = ring(b);
+        return ra < rb || (ra == rb && angle(a) < angle(b));
+    });
+    for (unsigned i = 0; i < tiles.size(); i++) {
+        tiles[i].index = i;
+    }
+
+    for (omp_lock_t &l : locks) {
+        omp_init_lock(&l);
+    }
+    reset();
+}
+
+TileScheduler::~TileScheduler() {
+    for (omp_lock_t &l : locks) {
+        omp_destroy_lock(&l);
+    }
+}
+
+void TileScheduler::reset() {
+    for (deque<unsigned> &q : queues) {
+        q.clear();
+    }
+    for (unsigned i = 0; i < tiles.size(); i++) {
+        queues[i%queues.size()].push_back(i);
+    }
+}
+
+bool TileScheduler::next(unsigned thread, Tile &tile) {
+    const unsigned nbQueues = queues.size();
+    thread %= nbQueues;
+
+    // Own queue from the front, the others from the back
+    for (unsigned k = 0; k < nbQueues; k++) {
+        const unsigned q = (thread+k)%nbQueues;
+        omp_set_lock(&locks[q]);
+        bool found = !queues[q].empty();
+        if (found) {
+            unsigned index;
+            if (k == 0) {
+                index = queues[q].front();
+                queues[q].pop_front();
+            }
+            else {
+                index = queues[q].back();
+                queues[q].pop_back();
+            }
+            tile = tiles[index];
+        }
+        omp_unset_lock(&locks[q]);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileScheduler::addTime(const Tile &tile, float milliseconds) {
+    tiles[tile.index].time += milliseconds;
+}
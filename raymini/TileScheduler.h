@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <omp.h>
+
+/**
+ * Split a picture into square tiles and share them between threads
+ *
+ * Tiles are ordered from the center of the picture outwards (spiral order)
+ * and dealt in turn to one queue per thread, so that every thread starts
+ * with central tiles. A thread whose queue is empty steals tiles from the
+ * end of the other queues.
+ */
+class TileScheduler {
+public:
+    /** Size of tiles in pixels, a multiple of RayPacket::TILE */
+    static const unsigned TILE_SIZE = 16;
+
+    class Tile {
+    public:
+        unsigned index;
+        unsigned x, y;
+        unsigned width, height;
+        /** Rendering time, in milliseconds, summed over every picture */
+        float time;
+    };
+
+    TileScheduler(unsigned width, unsigned height, unsigned nbThreads);
+    ~TileScheduler();
+
+    /** Queue every tile again, for the next picture */
+    void reset();
+
+    /** Next tile for thread, false once every tile has been taken */
+    bool next(unsigned thread, Tile &tile);
+
+    /** Add a rendering time to a tile */
+    void addTime(const Tile &tile, float milliseconds);
+
+    inline const std::vector<Tile> & getTiles() const { return tiles; }
+
+private:
+    std::vector<Tile> tiles;
+    std::vector<std::deque<unsigned>> queues;
+    std::vector<omp_lock_t> locks;
+
+    TileScheduler(const TileScheduler &) = delete;
+    TileScheduler & operator=(const TileScheduler &) = delete;
+};
@@ -34,11 +34,14 @@
 #ifndef VEC3D_H
 #define VEC3D_H
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
+#include "Sampler.h"
+
 
 template<typename T> class Vec3D;
 
@@ -217,6 +220,11 @@ public:
         u = getOrthogonal();
         v = crossProduct (*this, u);
     }
+    inline void getTwoNormalizedOrthogonals (Vec3D & u, Vec3D & v) const {
+        getTwoOrthogonals(u, v);
+        u.normalize();
+        v.normalize();
+    }
     inline Vec3D projectOn (const Vec3D & N, const Vec3D & P) const {
         T w = dotProduct (((*this) - P), N);
         return (*this) - (N * w);
@@ -307,17 +315,6 @@ public:
                       n[0]*q[0] + n[1]*q[1] + n[2]*q[2]);
     }
 
-    static inline Vec3D getRandomOnHemisphere(const Vec3D & dir) {
-        Vec3D q ( rand()/float(RAND_MAX) - 0.5,
-                    rand()/float(RAND_MAX) - 0.5,
-                    rand()/float(RAND_MAX) - 0.5);
-        q.normalize();
-        if(dotProduct(q, dir) < 0.0)
-            q = -q;
-
-        return q;
-        
-    }
 
     /** Rotate given normalized axis and angle */
     inline Vec3D rotate(const Vec3D &axis, const T &angle) const {
@@ -361,26 +358,37 @@ public:
         return result;
     }
 
-    inline Vec3D randRotate(const float & maxAngle) const {
-        auto random = []() -> T {
-            return T(rand())/T(RAND_MAX/2)-1;
-        };//rand in [-1,1[
-
-        Vec3D rVect(random(), random(), random());
-        rVect.projectOn(*this);
-        rVect.normalize();
-        rVect = *this + T(tan(float(rand())/float(RAND_MAX)*maxAngle))*rVect;
+    /**
+     * Direction within maxAngle of the normalized vector, with a density
+     * proportional to the cosine of the angle between them
+     * Uniform on the disc of radius sin(maxAngle) below the vector, then
+     * lifted onto the hemisphere (Malley's method).
+     */
+    inline Vec3D cosineRotate(const float & maxAngle, const std::pair<float, float> & sample) const {
+        Vec3D u, v;
+        getTwoNormalizedOrthogonals(u, v);
+        T radius = T(maxAngle < M_PI/2 ? sin(maxAngle) : 1)*T(sqrt(sample.first));
+        T angle = T(2*M_PI)*sample.second;
+        T height = sqrt(std::max(T(1) - radius*radius, T(0)));
+        Vec3D rVect = radius*T(cos(angle))*u + radius*T(sin(angle))*v + height*(*this);
         rVect.normalize();
 
         return rVect;
     }
 
-    std::vector<Vec3D> randRotate(const float & maxAngle, unsigned number) const {
+    /** See Sampler */
+    inline Vec3D cosineRotate(const float & maxAngle) const {
+        return cosineRotate(maxAngle, Sampler::local().get2D());
+    }
+
+    std::vector<Vec3D> cosineRotate(const float & maxAngle, unsigned number) const {
+        std::vector<std::pair<float, float>> samples(number);
+        Sampler::local().get2D(number, samples.data());
         std::vector<Vec3D> directions;
         directions.resize(number);
 
         for (unsigned i = 0 ; i < number ; i++)
-            directions[i] = randRotate(maxAngle);
+            directions[i] = cosineRotate(maxAngle, samples[i]);
 
         return directions;
     }
@@ -164,9 +164,10 @@ void Window::updateAntiAliasing(const Observable *observable) {
         rayTracer->isChanged(RayTracer::TYPE_AA_CHANGED);
     if (updateNbRayVisible) {
         bool isPT = rayTracer->getDepthPathTracing() != 0;
-        AANbRaySpinBox->setVisible(
-                (!isPT) &&
-                rayTracer->getTypeAntiAliasing() != AntiAliasing::NONE);
+        bool isAA = (!isPT) &&
+                rayTracer->getTypeAntiAliasing() != AntiAliasing::NONE;
+        AANbRaySpinBox->setVisible(isAA);
+        AAAdaptiveSpinBox->setVisible(isAA);
     }
     if (rayTracer->isChanged(RayTracer::NB_RAYS_AA_CHANGED)) {
         AANbRaySpinBox->disconnect();
@@ -174,6 +175,12 @@ void Window::updateAntiAliasing(const Observable *observable) {
         connect(AANbRaySpinBox, SIGNAL(valueChanged(int)),
                 controller, SLOT(windowSetNbRayAntiAliasing(int)));
     }
+    if (rayTracer->isChanged(RayTracer::ADAPTIVE_ERROR_CHANGED)) {
+        AAAdaptiveSpinBox->disconnect();
+        AAAdaptiveSpinBox->setValue(rayTracer->getAdaptiveError());
+        connect(AAAdaptiveSpinBox, SIGNAL(valueChanged(double)),
+                controller, SLOT(windowSetAdaptiveError(double)));
+    }
 }
 
 void Window::updateAmbientOcclusion(const Observable *observable) {
@@ -219,6 +226,7 @@ void Window::updatePathTracing(const Observable *observable) {
         PTNbRaySpinBox->setVisible(isPT);
         PTOnlyCheckBox->setVisible(isPT);
         PBGICheckBox->setVisible(!isPT);
+        PBGIIntensitySpinBox->setVisible(!isPT);
     }
     if (rayTracer->isChanged(RayTracer::NB_RAYS_PT_CHANGED)) {
         PTNbRaySpinBox->disconnect();
@@ -232,6 +240,12 @@ void Window::updatePathTracing(const Observable *observable) {
         connect(PTIntensitySpinBox, SIGNAL(valueChanged(double)),
                 controller, SLOT(windowSetIntensityPathTracing(double)));
     }
+    if (rayTracer->isChanged(RayTracer::INTENSITY_PBGI_CHANGED)) {
+        PBGIIntensitySpinBox->disconnect();
+        PBGIIntensitySpinBox->setValue(rayTracer->getIntensityPBGI());
+        connect(PBGIIntensitySpinBox, SIGNAL(valueChanged(double)),
+                controller, SLOT(windowSetIntensityPBGI(double)));
+    }
 }
 
 void Window::updateBackgroundColor(const Observable *observable) {
@@ -880,6 +894,16 @@ void Window::initControlWidget() {
     AALayout->addWidget(AANbRaySpinBox);
     connect(AANbRaySpinBox, SIGNAL(valueChanged(int)), controller, SLOT(windowSetNbRayAntiAliasing(int)));
 
+    AAAdaptiveSpinBox = new QDoubleSpinBox(AAGroupBox);
+    AAAdaptiveSpinBox->setPrefix("Adaptive error: ");
+    AAAdaptiveSpinBox->setSpecialValueText("Not adaptive");
+    AAAdaptiveSpinBox->setDecimals(3);
+    AAAdaptiveSpinBox->setMinimum(0);
+    AAAdaptiveSpinBox->setMaximum(1);
+    AAAdaptiveSpinBox->setSingleStep(0.005);
+    AALayout->addWidget(AAAdaptiveSpinBox);
+    connect(AAAdaptiveSpinBox, SIGNAL(valueChanged(double)), controller, SLOT(windowSetAdaptiveError(double)));
+
     rayTabs->addTab(AAGroupBox, "Anti Aliasing");
 
     //  RayGroup: Ambient occlusion
@@ -968,6 +992,14 @@ void Window::initControlWidget() {
     connect (PBGICheckBox, SIGNAL (clicked (bool)), controller, SLOT (windowSetRayTracerMode (bool)));
     PTLayout->addWidget (PBGICheckBox);
 
+    PBGIIntensitySpinBox = new QDoubleSpinBox(PTGroupBox);
+    PBGIIntensitySpinBox->setPrefix ("PBGI intensity: ");
+    PBGIIntensitySpinBox->setMinimum (0.2);
+    PBGIIntensitySpinBox->setMaximum (100.0);
+    PBGIIntensitySpinBox->setSingleStep(0.2);
+    connect(PBGIIntensitySpinBox, SIGNAL(valueChanged(double)), controller, SLOT(windowSetIntensityPBGI(double)));
+    PTLayout->addWidget (PBGIIntensitySpinBox);
+
     rayTabs->addTab(PTGroupBox, "Path Tracing");
 
     //  RayGroup: Focal
@@ -1006,7 +1038,7 @@ void Window::initControlWidget() {
     QVBoxLayout * mBlurLayout = new QVBoxLayout(mBlurGroupBox);
 
     mBlurNbImagesSpinBox = new QSpinBox(PTGroupBox);
-    mBlurNbImagesSpinBox->setSuffix (" images");
+    mBlurNbImagesSpinBox->setSuffix (" times per pixel");
     mBlurNbImagesSpinBox->setMinimum (1);
     mBlurNbImagesSpinBox->setMaximum (100);
     mBlurNbImagesSpinBox->setVisible(false);
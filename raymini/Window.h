@@ -116,8 +116,10 @@ private :
     QCheckBox *PTOnlyCheckBox;
     QCheckBox *PBGICheckBox;
     QDoubleSpinBox * PTIntensitySpinBox;
+    QDoubleSpinBox * PBGIIntensitySpinBox;
 
     QSpinBox *AANbRaySpinBox;
+    QDoubleSpinBox *AAAdaptiveSpinBox;
 
     QSpinBox *AONbRaysSpinBox;
     QSpinBox *AOMaxAngleSpinBox;
@@ -0,0 +1,87 @@
+# Rendering core shared by the headless targets, without any GUI file
+CONFIG  += qt warn_on console release thread
+CONFIG  -= app_bundle
+QMAKE_CXXFLAGS += -std=c++0x -g -fopenmp
+QMAKE_LFLAGS += -fopenmp
+# QImage lives in QtGui, no widget is ever created
+QT = core gui
+HEADERS = Vertex.h \
+          Triangle.h \
+          Mesh.h \
+          MeshAdjacency.h \
+          MappedFile.h \
+          MeshCache.h \
+          MeshLoader.h \
+          BoundingBox.h \
+          Material.h \
+          Object.h \
+          Light.h \
+          Scene.h \
+          RayTracer.h \
+          Ray.h \
+          KDtree.h \
+          KDtreeBuilder.h \
+          BVH.h \
+          PackedBoxes.h \
+          PackedTriangle.h \
+          RenderMesh.h \
+          RayPacket.h \
+          TileScheduler.h \
+          Noise.h \
+          AntiAliasing.h \
+          Color.h \
+          Film.h \
+          Random.h \
+          Sampler.h \
+          Shadow.h \
+          Texture.h \
+          Observer.h \
+          Observable.h \
+          BaseController.h \
+          CliController.h \
+          Focus.h \
+          Surfel.h \
+          PointCloud.h \
+          ProgressBar.h \
+          NamedClass.h \
+          NoiseUser.h \
+          Brdf.h \
+          PBGI.h \
+          Octree.h
+
+SOURCES = Vertex.cpp \
+          Triangle.cpp \
+          Mesh.cpp \
+          MeshAdjacency.cpp \
+          MappedFile.cpp \
+          MeshCache.cpp \
+          MeshLoader.cpp \
+          BoundingBox.cpp \
+          Material.cpp \
+          Object.cpp \
+          Light.cpp \
+          Scene.cpp \
+          RayTracer.cpp \
+          Ray.cpp \
+          RenderMesh.cpp \
+          KDtree.cpp \
+          KDtreeBuilder.cpp \
+          BVH.cpp \
+          TileScheduler.cpp \
+          Film.cpp \
+          Brdf.cpp \
+          Noise.cpp \
+          AntiAliasing.cpp \
+          Texture.cpp \
+          Color.cpp \
+          Shadow.cpp \
+          Observable.cpp \
+          Focus.cpp \
+          Surfel.cpp \
+          PointCloud.cpp \
+          Octree.cpp \
+          ProgressBar.cpp \
+          PBGI.cpp \
+          CliController.cpp
+
+    DESTDIR=.
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET   = raymini-bench
+include(core.pri)
+# fork() and getrusage()
+SOURCES += Bench.cpp
+
+MOC_DIR = .tmp-bench
+OBJECTS_DIR = .tmp-bench
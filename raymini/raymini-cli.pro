@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET   = raymini-cli
+include(core.pri)
+SOURCES += CliMain.cpp
+
+MOC_DIR = .tmp-cli
+OBJECTS_DIR = .tmp-cli
@@ -10,6 +10,10 @@ HEADERS = Window.h \
           Vertex.h \
           Triangle.h \
           Mesh.h \
+          MeshAdjacency.h \
+          MappedFile.h \
+          MeshCache.h \
+          MeshLoader.h \
           BoundingBox.h \
           Material.h \
           Object.h \
@@ -18,13 +22,24 @@ HEADERS = Window.h \
           RayTracer.h \
           Ray.h \
           KDtree.h \
+          KDtreeBuilder.h \
+          BVH.h \
+          PackedBoxes.h \
+          PackedTriangle.h \
+          RenderMesh.h \
+          RayPacket.h \
+          TileScheduler.h \
           Noise.h \
           AntiAliasing.h \
           Color.h \
+          Film.h \
+          Random.h \
+          Sampler.h \
           Shadow.h \
           Texture.h \
           Observer.h \
           Observable.h \
+          BaseController.h \
           Controller.h \
           WindowModel.h \
           Focus.h \
@@ -40,10 +55,15 @@ HEADERS = Window.h \
 
 SOURCES = Window.cpp \
           GLViewer.cpp \
+          GLDrawing.cpp \
           QTUtils.cpp \
           Vertex.cpp \
           Triangle.cpp \
           Mesh.cpp \
+          MeshAdjacency.cpp \
+          MappedFile.cpp \
+          MeshCache.cpp \
+          MeshLoader.cpp \
           BoundingBox.cpp \
           Material.cpp \
           Object.cpp \
@@ -51,7 +71,12 @@ SOURCES = Window.cpp \
           Scene.cpp \
           RayTracer.cpp \
           Ray.cpp \
+          RenderMesh.cpp \
           KDtree.cpp \
+          KDtreeBuilder.cpp \
+          BVH.cpp \
+          TileScheduler.cpp \
+          Film.cpp \
           Brdf.cpp \
           Noise.cpp \
           AntiAliasing.cpp \